@@ -1,4 +1,9 @@
+#ifndef REGISTRATION_PRUNE_H
+#define REGISTRATION_PRUNE_H
+
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "Common.h"
 #include "back_end/reglib.h"
@@ -8,6 +13,103 @@
 
 namespace Registration
 {
+    // 一致性图的位集邻接矩阵。每行 ceil(N/64) 个 64 位字，边 (i,j) 同时写入第 i 行和第 j 行。
+    // 按位或合并与顺序无关，因此多线程构建的结果是确定的。
+    class ConsistencyBitset
+    {
+    public:
+        ConsistencyBitset(): num_vertices(0), num_words(0) {}
+
+        explicit ConsistencyBitset(int num_vertices_) { resize(num_vertices_); }
+
+        void resize(int num_vertices_) {
+            num_vertices = num_vertices_;
+            num_words = (num_vertices + 63) / 64;
+            words.assign(size_t(num_vertices) * num_words, 0);
+        }
+
+        int size() const { return num_vertices; }
+
+        // 添加无向边
+        void setEdge(int i, int j) {
+            row(i)[j >> 6] |= uint64_t(1) << (j & 63);
+            row(j)[i >> 6] |= uint64_t(1) << (i & 63);
+        }
+
+        bool hasEdge(int i, int j) const {
+            return (row(i)[j >> 6] >> (j & 63)) & 1;
+        }
+
+        // 顶点的度
+        int degree(int i) const {
+            int d = 0;
+            for (int w = 0; w < num_words; ++w) d += __builtin_popcountll(row(i)[w]);
+            return d;
+        }
+
+        // 边的数量
+        uint64_t numEdges() const {
+            uint64_t d = 0;
+            for (int i = 0; i < num_vertices; ++i) d += degree(i);
+            return d / 2;
+        }
+
+        uint64_t *row(int i) { return words.data() + size_t(i) * num_words; }
+
+        const uint64_t *row(int i) const { return words.data() + size_t(i) * num_words; }
+
+        // 按行序 (i<j) 把边写入最大团求解器的图
+        void toGraph(clique_solver::Graph &graph) const {
+            for (int i = 0; i < num_vertices; ++i) {
+                const uint64_t *r = row(i);
+                for (int w = (i + 1) >> 6; w < num_words; ++w) {
+                    uint64_t bits = r[w];
+                    if (w == ((i + 1) >> 6)) bits &= ~uint64_t(0) << ((i + 1) & 63);  // 只取上三角
+                    while (bits) {
+                        int j = (w << 6) + __builtin_ctzll(bits);
+                        graph.addEdge(i, j);
+                        bits &= bits - 1;
+                    }
+                }
+            }
+        }
+
+    private:
+        int num_vertices;
+        int num_words;
+        std::vector<uint64_t> words;
+    };
+
+    // 匹配对两端的中心点，按坐标分量连续存储 (SoA)，长度补齐到 64 的倍数，便于按块向量化。
+    // 用 double 存储，距离差贴近阈值时与 GraphVertex::consistent 的判断一致
+    struct MatchedCentroids
+    {
+        int num_corr = 0;
+        std::vector<double> src_x, src_y, src_z;
+        std::vector<double> ref_x, ref_y, ref_z;
+
+        void assign(const std::vector<fmfusion::NodePtr> &src_nodes,
+                    const std::vector<fmfusion::NodePtr> &ref_nodes,
+                    const std::vector<fmfusion::NodePair> &match_pairs);
+
+        void assign(const std::vector<Eigen::Vector3d> &src_points,
+                    const std::vector<Eigen::Vector3d> &ref_points);
+
+        Eigen::Vector3d src(int k) const { return {src_x[k], src_y[k], src_z[k]}; }
+
+        Eigen::Vector3d ref(int k) const { return {ref_x[k], ref_y[k], ref_z[k]}; }
+
+    private:
+        void resize(int num_corr_);
+
+        void set(int k, const Eigen::Vector3d &src, const Eigen::Vector3d &ref);
+    };
+
+    // 成对一致性检验: 匹配 i,j 一致当且仅当 | |src_i - src_j| - |ref_i - ref_j| | < noise_bound。
+    // 每个阈值输出一个邻接位集。每个线程独占若干行，直接写位集，不需要加锁
+    void buildConsistencyBitsets(const MatchedCentroids &centroids,
+                                 const std::vector<double> &noise_bound_vec,
+                                 std::vector<ConsistencyBitset> &adjacency);
 
     void pruneInsOutliers(const fmfusion::RegistrationConfig &config,
                         const std::vector<fmfusion::NodePtr> &src_nodes,
@@ -18,3 +120,4 @@ namespace Registration
     
 } // namespace Registration
 
+#endif // REGISTRATION_PRUNE_H
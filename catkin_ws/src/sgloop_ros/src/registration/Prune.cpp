@@ -1,81 +1,126 @@
+#include <cmath>
+
 #include "registration/Prune.h"
 
 namespace Registration
 {
 
+void MatchedCentroids::resize(int num_corr_) {
+    num_corr = num_corr_;
+//    补齐部分填0，对应的位在输出时被屏蔽
+    size_t padded = size_t((num_corr + 63) / 64) * 64;
+    for (auto *v: {&src_x, &src_y, &src_z, &ref_x, &ref_y, &ref_z}) v->assign(padded, 0.0);
+}
+
+void MatchedCentroids::set(int k, const Eigen::Vector3d &src, const Eigen::Vector3d &ref) {
+    src_x[k] = src.x();
+    src_y[k] = src.y();
+    src_z[k] = src.z();
+    ref_x[k] = ref.x();
+    ref_y[k] = ref.y();
+    ref_z[k] = ref.z();
+}
+
+void MatchedCentroids::assign(const std::vector<fmfusion::NodePtr> &src_nodes,
+                              const std::vector<fmfusion::NodePtr> &ref_nodes,
+                              const std::vector<fmfusion::NodePair> &match_pairs) {
+    resize(match_pairs.size());
+    for (int k = 0; k < num_corr; ++k)
+        set(k, src_nodes[match_pairs[k].first]->centroid, ref_nodes[match_pairs[k].second]->centroid);
+}
+
+void MatchedCentroids::assign(const std::vector<Eigen::Vector3d> &src_points,
+                              const std::vector<Eigen::Vector3d> &ref_points) {
+    resize(src_points.size());
+    for (int k = 0; k < num_corr; ++k) set(k, src_points[k], ref_points[k]);
+}
+
+void buildConsistencyBitsets(const MatchedCentroids &centroids,
+                             const std::vector<double> &noise_bound_vec,
+                             std::vector<ConsistencyBitset> &adjacency) {
+    int num_corr = centroids.num_corr;
+    int num_graphs = noise_bound_vec.size();
+    adjacency.assign(num_graphs, ConsistencyBitset(num_corr));
+    if (num_corr < 2) return;
+
+    int num_words = (num_corr + 63) / 64;
+    const std::vector<double> &thresholds = noise_bound_vec;
+    const double *sx = centroids.src_x.data(), *sy = centroids.src_y.data(), *sz = centroids.src_z.data();
+    const double *rx = centroids.ref_x.data(), *ry = centroids.ref_y.data(), *rz = centroids.ref_z.data();
+
+//    第i行的所有字都由同一个线程写入，计算完整的一行(而不只是上三角)，省去对称写入时的竞争
+#pragma omp parallel for default(none) shared(num_corr, num_words, num_graphs, thresholds, adjacency, sx, sy, sz, rx, ry, rz) schedule(static)
+    for (int i = 0; i < num_corr; ++i) {
+        alignas(64) double diff[64];
+        for (int w = 0; w < num_words; ++w) {
+            const int j0 = w * 64;
+//            一个块内计算64个距离差，循环长度固定，编译器可以向量化
+            for (int b = 0; b < 64; ++b) {
+                double dx = sx[i] - sx[j0 + b], dy = sy[i] - sy[j0 + b], dz = sz[i] - sz[j0 + b];
+                double ex = rx[i] - rx[j0 + b], ey = ry[i] - ry[j0 + b], ez = rz[i] - rz[j0 + b];
+                diff[b] = std::abs(std::sqrt(dx * dx + dy * dy + dz * dz) - std::sqrt(ex * ex + ey * ey + ez * ez));
+            }
+//            屏蔽自环和补齐部分
+            uint64_t valid = ~uint64_t(0);
+            if (i >= j0 && i < j0 + 64) valid &= ~(uint64_t(1) << (i - j0));
+            if (j0 + 64 > num_corr) valid &= ~uint64_t(0) >> (j0 + 64 - num_corr);
+            for (int level = 0; level < num_graphs; ++level) {
+                const double thd = thresholds[level];
+                uint64_t word = 0;
+                for (int b = 0; b < 64; ++b) word |= uint64_t(diff[b] < thd) << b;
+                adjacency[level].row(i)[w] = word & valid;
+            }
+        }
+    }
+}
+
 void pruneInsOutliers(const fmfusion::RegistrationConfig &config,
                       const std::vector<fmfusion::NodePtr> &src_nodes,
                       const std::vector<fmfusion::NodePtr> &ref_nodes,
                       const std::vector<fmfusion::NodePair> &match_pairs,
                       std::vector<bool> &pruned_true_masks) {
 
-//    存储配准单位
-    std::vector<clique_solver::GraphVertex::Ptr> v1, v2;
-//    一致性图的节点有多种类型
-    clique_solver::VertexInfo vertex_info;
-//    不同的节点会有不同的一致性测量函数
-    vertex_info.type = clique_solver::VertexType::POINT;
 //    一致性判断的阈值，可以设置为多个，从小到大，会得到多个内点结果。
 //  由于Instance中心点不确定性较大，我们这里只选取一个比较大的阈值，不做精确估计
 //  注意，阈值越大，图越稠密，最大团求解时间也会上升
-    vertex_info.noise_bound_vec = config.noise_bound_vec; //{1.0};
-//    初始化配准节点
-    for (const auto &src_node: src_nodes) {
-        const Eigen::Vector3d &center = src_node->centroid;
-        v1.push_back(clique_solver::create_vertex(center, vertex_info));
-    }
-    for (const auto &ref_node: ref_nodes) {
-        const Eigen::Vector3d &center = ref_node->centroid;
-        v2.push_back(clique_solver::create_vertex(center, vertex_info));
-    }
-
+    const std::vector<double> &noise_bound_vec = config.noise_bound_vec; //{1.0};
 //    匹配的数量
     uint64_t num_corr = match_pairs.size();
-//    TRIM(Translation Rotation Invariant Measurements)的数量
-    uint64_t num_tims = num_corr * (num_corr - 1) / 2;
+//    匹配两端的中心点按SoA存储，不再为每个节点和每个TRIM(Translation Rotation Invariant Measurements)创建图顶点
+    MatchedCentroids centroids;
+    centroids.assign(src_nodes, ref_nodes, match_pairs);
+
 //    初始化一致性图和最大团
-    std::vector<clique_solver::Graph> graphs;
-    std::vector<std::vector<int>> max_cliques;
-    int num_graphs = vertex_info.noise_bound_vec.size();
-    for (int i = 0; i < num_graphs; ++i) {
-        clique_solver::Graph graph;
-        graph.clear();
-        graph.setType(false);
-        graph.populateVertices(num_corr);
-        graphs.push_back(graph);
-        max_cliques.push_back(std::vector<int>());
-    }
+    int num_graphs = noise_bound_vec.size();
+    std::vector<ConsistencyBitset> adjacency;
+    std::vector<clique_solver::Graph> graphs(num_graphs);
+    std::vector<std::vector<int>> max_cliques(num_graphs);
 
-//    构建多个一致性图
-#pragma omp parallel for default(none) shared(num_corr, num_tims, v1, v2, graphs, match_pairs, num_graphs)
-    for (size_t k = 0; k < num_tims; ++k) {
-        size_t i, j;
-//        一共需要进行num_tims次边的计算，第k次对应第i，j个节点
-        std::tie(i, j) = clique_solver::k2ij(k, num_corr);
-//        由于之前的noise_bound_vec会有多个阈值，因此results也是多个
-        const auto &results = (*v1[match_pairs[j].first] - *v1[match_pairs[i].first])->consistent(
-                *(*v2[match_pairs[j].second] - *v2[match_pairs[i].second]));
-        for (int level = 0; level < num_graphs; ++level) {
-//            判断是否通过一致性检验
-            if (results(level) > 0.0) {
-#pragma omp critical
-                {
-                    graphs[level].addEdge(i, j);
-                }
-            }
-        }
-    }
+//    构建多个一致性图的邻接位集
+    buildConsistencyBitsets(centroids, noise_bound_vec, adjacency);
 
+//    按行序从位集生成一致性图，边的顺序与线程调度无关
+    for (int level = 0; level < num_graphs; ++level) {
+        graphs[level].clear();
+        graphs[level].setType(false);
+        graphs[level].populateVertices(num_corr);
+        adjacency[level].toGraph(graphs[level]);
+    }
 
 //  求解最大团
     clique_solver::MaxCliqueSolver::Params clique_params;
     clique_params.solver_mode = clique_solver::MaxCliqueSolver::CLIQUE_SOLVER_MODE::PMC_EXACT;
-    int prune_level = 0;
-//    渐进式求解每个图的最大团
-    for (int level = 0; level < num_graphs; ++level) {
+    if (num_graphs == 1) {
         clique_solver::MaxCliqueSolver mac_solver(clique_params);
-        max_cliques[level] = mac_solver.findMaxClique(graphs[level], prune_level);
-        prune_level = max_cliques[level].size();
+        max_cliques[0] = mac_solver.findMaxClique(graphs[0], 0);
+    } else {
+//        多个阈值的图相互独立，并行求解。第0层原本就不使用剪枝下界，结果不变；
+//        其余层不再以前一层的团大小作为下界，只是少了剪枝，最大团仍然是精确解
+#pragma omp parallel for default(none) shared(graphs, max_cliques, clique_params, num_graphs) schedule(dynamic, 1)
+        for (int level = 0; level < num_graphs; ++level) {
+            clique_solver::MaxCliqueSolver mac_solver(clique_params);
+            max_cliques[level] = mac_solver.findMaxClique(graphs[level], 0);
+        }
     }
 //    最大团的元素表示第几个匹配关系是正确的。排序，为了好看。
     for (int level = 0; level < num_graphs; ++level) {
@@ -92,7 +137,7 @@ void pruneInsOutliers(const fmfusion::RegistrationConfig &config,
         const auto &src_node = src_nodes[pair.first];
         const auto &ref_node = ref_nodes[pair.second];
         msg << "(" << pair.first << "," << pair.second << ") "
-            << "(" << src_node->semantic << "," << ref_node->semantic << ")\n";
+            << "(" << src_node->get_semantic() << "," << ref_node->get_semantic() << ")\n";
     }
     // std::cout << msg.str() << std::endl;
 }
@@ -0,0 +1,101 @@
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "registration/Prune.h"
+
+namespace
+{
+
+using namespace Registration;
+
+//    参考实现: 为每个匹配创建 POINT 类型的图顶点，用 GraphVertex::consistent 判断每一对
+void buildConsistencyBitsetsByVertex(const MatchedCentroids &centroids,
+                                     const clique_solver::VertexInfo &vertex_info,
+                                     std::vector<ConsistencyBitset> &adjacency) {
+    int num_corr = centroids.num_corr;
+    int num_graphs = vertex_info.noise_bound_vec.size();
+    adjacency.assign(num_graphs, ConsistencyBitset(num_corr));
+
+    std::vector<clique_solver::GraphVertex::Ptr> v1, v2;
+    for (int k = 0; k < num_corr; ++k) {
+        v1.push_back(clique_solver::create_vertex(centroids.src(k), vertex_info));
+        v2.push_back(clique_solver::create_vertex(centroids.ref(k), vertex_info));
+    }
+    for (int i = 0; i < num_corr; ++i) {
+        for (int j = i + 1; j < num_corr; ++j) {
+            const auto &results = (*v1[j] - *v1[i])->consistent(*(*v2[j] - *v2[i]));
+            for (int level = 0; level < num_graphs; ++level) {
+                if (results(level) > 0.0) adjacency[level].setEdge(i, j);
+            }
+        }
+    }
+}
+
+//    第0个匹配在原点。沿x轴放置距离差正好为阈值、两倍阈值及其附近的匹配，检查 < 与 <= 以及阈值系数。
+//    其余为随机匹配，距离差在阈值附近分布
+void makeMatches(const std::vector<double> &noise_bound_vec, unsigned int seed,
+                 std::vector<Eigen::Vector3d> &src_points, std::vector<Eigen::Vector3d> &ref_points) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> coord(-20.0, 20.0);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    double max_bound = 0.0;
+    for (double bound: noise_bound_vec) max_bound = std::max(max_bound, bound);
+
+    src_points.emplace_back(Eigen::Vector3d::Zero());
+    ref_points.emplace_back(Eigen::Vector3d::Zero());
+    for (double bound: noise_bound_vec) {
+        for (double scale: {1.0, 2.0}) {
+            for (double eps: {0.0, -1e-9, 1e-9}) {
+                src_points.emplace_back(4.0, 0.0, 0.0);
+                ref_points.emplace_back(4.0 + scale * bound + eps, 0.0, 0.0);
+            }
+        }
+    }
+    while (src_points.size() < 150) {
+        Eigen::Vector3d src(coord(rng), coord(rng), coord(rng));
+        src_points.push_back(src);
+        ref_points.emplace_back(src + 1.5 * max_bound * Eigen::Vector3d(unit(rng), unit(rng), unit(rng)));
+    }
+}
+
+}
+
+//    核函数的邻接位集应与 GraphVertex::consistent 逐边一致
+TEST(PruneTest, ConsistencyKernelMatchesGraphVertex) {
+    const std::vector<std::vector<double>> bound_sets = {{1.0}, {0.2, 0.5, 1.0}, {0.05, 3.0}};
+    for (const auto &noise_bound_vec: bound_sets) {
+        clique_solver::VertexInfo vertex_info;
+        vertex_info.type = clique_solver::VertexType::POINT;
+        vertex_info.noise_bound_vec = noise_bound_vec;
+
+        for (unsigned int seed = 0; seed < 4; ++seed) {
+            std::vector<Eigen::Vector3d> src_points, ref_points;
+            makeMatches(noise_bound_vec, seed, src_points, ref_points);
+            MatchedCentroids centroids;
+            centroids.assign(src_points, ref_points);
+
+            std::vector<ConsistencyBitset> kernel_adjacency, vertex_adjacency;
+            buildConsistencyBitsets(centroids, noise_bound_vec, kernel_adjacency);
+            buildConsistencyBitsetsByVertex(centroids, vertex_info, vertex_adjacency);
+
+            ASSERT_EQ(kernel_adjacency.size(), noise_bound_vec.size());
+            for (size_t level = 0; level < noise_bound_vec.size(); ++level) {
+                for (int i = 0; i < centroids.num_corr; ++i) {
+                    EXPECT_FALSE(kernel_adjacency[level].hasEdge(i, i));
+                    for (int j = i + 1; j < centroids.num_corr; ++j) {
+                        EXPECT_EQ(kernel_adjacency[level].hasEdge(i, j), vertex_adjacency[level].hasEdge(i, j))
+                                    << "bound " << noise_bound_vec[level] << ", seed " << seed
+                                    << ", edge (" << i << "," << j << ")";
+                        EXPECT_EQ(kernel_adjacency[level].hasEdge(i, j), kernel_adjacency[level].hasEdge(j, i));
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,106 @@
+// Benchmark of CPU-only loop detection latency.
+// Two saved scene graphs are encoded and matched on the cpu for a number of iterations, then the mean
+// latency of each stage and the accumulated per-module inference latency are printed.
+// Usage: BenchmarkLoopCPU --config config/realsense.yaml --weights_dir torchscript
+//                         --src_scene <map folder> --ref_scene <map folder>
+//                         [--iter 10] [--intra_op_threads 0] [--onednn_fusion]
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "open3d/Open3D.h"
+
+#include "tools/Utility.h"
+#include "sgloop/Graph.h"
+#include "sgloop/LoopDetector.h"
+#include "sgloop/Initialization.h"
+
+int main(int argc, char *argv[])
+{
+    using namespace open3d;
+
+    std::string config_file = utility::GetProgramOptionAsString(argc, argv, "--config");
+    std::string weights_dir = utility::GetProgramOptionAsString(argc, argv, "--weights_dir");
+    std::string src_scene = utility::GetProgramOptionAsString(argc, argv, "--src_scene");
+    std::string ref_scene = utility::GetProgramOptionAsString(argc, argv, "--ref_scene");
+    int iterations = utility::GetProgramOptionAsInt(argc, argv, "--iter", 10);
+
+    auto sg_config = fmfusion::utility::create_scene_graph_config(config_file, false);
+    if (sg_config == nullptr) {
+        utility::LogWarning("Failed to create scene graph config.");
+        return 0;
+    }
+
+    // Force cpu inference. Thread number and oneDNN fusion follow the config unless overridden.
+    sg_config->sgnet.device = "cpu";
+    sg_config->sgnet.intra_op_threads =
+            utility::GetProgramOptionAsInt(argc, argv, "--intra_op_threads", sg_config->sgnet.intra_op_threads);
+    if (utility::ProgramOptionExists(argc, argv, "--onednn_fusion")) sg_config->sgnet.onednn_fusion = true;
+    std::cout << "SGNet: \n" << sg_config->sgnet.print_msg();
+
+    // Scene graphs
+    std::shared_ptr<fmfusion::Graph> src_graph, ref_graph;
+    if (!fmfusion::init_scene_graph(*sg_config, src_scene, src_graph)
+        || !fmfusion::init_scene_graph(*sg_config, ref_scene, ref_graph)) {
+        utility::LogWarning("Failed to load the scene graphs.");
+        return 0;
+    }
+    const fmfusion::DataDict src_data_dict = src_graph->extract_data_dict();
+    const fmfusion::DataDict ref_data_dict = ref_graph->extract_data_dict();
+    int Ns = src_graph->get_const_nodes().size();
+    int Nr = ref_graph->get_const_nodes().size();
+
+    auto loop_detector = std::make_shared<fmfusion::LoopDetector>(sg_config->loop_detector,
+                                                                 sg_config->shape_encoder,
+                                                                 sg_config->sgnet,
+                                                                 weights_dir, 0,
+                                                                 std::vector<std::string>{"ref"});
+
+    // Stage latency (ms): scene graph encoding, node matching, shape encoding, point matching
+    double stage_ms[4] = {0.0, 0.0, 0.0, 0.0};
+    int matches = 0, correspondences = 0;
+    utility::Timer timer;
+
+    for (int it = 0; it < iterations; it++) {
+        timer.Start();
+        loop_detector->encode_ref_scene_graph("ref", *ref_graph);
+        loop_detector->encode_src_scene_graph(*src_graph);
+        timer.Stop();
+        stage_ms[0] += timer.GetDurationInMillisecond();
+
+        std::vector<std::pair<uint32_t, uint32_t>> match_pairs;
+        std::vector<float> match_scores;
+        timer.Start();
+        matches = loop_detector->match_nodes("ref", match_pairs, match_scores);
+        timer.Stop();
+        stage_ms[1] += timer.GetDurationInMillisecond();
+
+        float encoding_time;
+        timer.Start();
+        bool shape_encoded = loop_detector->encode_concat_sgs("ref", Nr, ref_data_dict, Ns, src_data_dict,
+                                                              encoding_time);
+        timer.Stop();
+        stage_ms[2] += timer.GetDurationInMillisecond();
+        if (!shape_encoded || matches < 1) continue;
+
+        fmfusion::CorrespondenceBuffer corr;
+        timer.Start();
+        correspondences = loop_detector->match_instance_points("ref", match_pairs, corr);
+        timer.Stop();
+        stage_ms[3] += timer.GetDurationInMillisecond();
+    }
+
+    std::cout << "CPU loop detection over " << iterations << " iterations ("
+              << Ns << " src nodes, " << Nr << " ref nodes, "
+              << matches << " matches, " << correspondences << " correspondences)\n"
+              << std::fixed << std::setprecision(1)
+              << " - encode scene graphs: " << stage_ms[0] / iterations << " ms\n"
+              << " - match nodes: " << stage_ms[1] / iterations << " ms\n"
+              << " - encode shapes: " << stage_ms[2] / iterations << " ms\n"
+              << " - match instance points: " << stage_ms[3] / iterations << " ms\n";
+    std::cout << loop_detector->print_inference_latency();
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Benchmark of the grid-hashed correspondence NMS against the quadratic greedy NMS.
+// Correspondences are uniform in a 10x10x2 m box with uniform scores.
+// Usage: BenchmarkNMS [--number 10000,30000,100000] [--dist_thd 0.05] [--max_keep 1000] [--skip_quadratic]
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "open3d/Open3D.h"
+
+#include "tools/CorrespondenceFilter.h"
+
+// The greedy NMS that the grid filter replaces: compare each candidate against every kept one.
+std::vector<int> quadratic_nms(const std::vector<Eigen::Vector3d> &points, const std::vector<float> &scores,
+                               double dist_thd)
+{
+    std::vector<int> order(scores.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&scores](int a, int b) {
+        return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+    });
+
+    std::vector<int> kept;
+    for (int i: order) {
+        bool add = true;
+        for (size_t j = 0; j < kept.size() && add; j++)
+            if ((points[i] - points[kept[j]]).norm() < dist_thd) add = false;
+        if (add) kept.push_back(i);
+    }
+    return kept;
+}
+
+int main(int argc, char *argv[])
+{
+    using namespace open3d;
+
+    std::string number_list = utility::GetProgramOptionAsString(argc, argv, "--number", "10000,30000,100000");
+    double dist_thd = utility::GetProgramOptionAsDouble(argc, argv, "--dist_thd", 0.05);
+    int max_keep = utility::GetProgramOptionAsInt(argc, argv, "--max_keep", 1000);
+    bool skip_quadratic = utility::ProgramOptionExists(argc, argv, "--skip_quadratic");
+
+    std::vector<int> numbers;
+    std::stringstream ss(number_list);
+    for (std::string item; std::getline(ss, item, ',');) numbers.push_back(std::stoi(item));
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<double> coord(-5.0, 5.0);
+    std::uniform_real_distribution<float> score(0.0, 1.0);
+    fmfusion::CorrespondenceNMS nms(dist_thd);
+    utility::Timer timer;
+
+    for (int N: numbers) {
+        std::vector<Eigen::Vector3d> points(N);
+        std::vector<float> scores(N);
+        for (int i = 0; i < N; i++) {
+            points[i] = Eigen::Vector3d(coord(rng), coord(rng), 0.2 * coord(rng));
+            scores[i] = score(rng);
+        }
+
+        timer.Start();
+        std::vector<int> kept = nms.filter(points, scores);
+        timer.Stop();
+        double grid_ms = timer.GetDurationInMillisecond();
+
+        timer.Start();
+        std::vector<int> kept_top = nms.filter(points, scores, max_keep);
+        timer.Stop();
+        double top_ms = timer.GetDurationInMillisecond();
+
+        std::stringstream msg;
+        msg << N << " correspondences: kept " << kept.size()
+            << ", grid " << grid_ms << " ms, grid top-" << max_keep << " " << top_ms << " ms";
+
+        if (!skip_quadratic) {
+            timer.Start();
+            std::vector<int> reference = quadratic_nms(points, scores, dist_thd);
+            timer.Stop();
+            bool same = reference == kept
+                        && std::equal(kept_top.begin(), kept_top.end(), reference.begin());
+            msg << ", quadratic " << timer.GetDurationInMillisecond() << " ms"
+                << (same ? ", identical" : ", MISMATCH");
+            if (!same) {
+                std::cout << msg.str() << std::endl;
+                return 1;
+            }
+        }
+        std::cout << msg.str() << std::endl;
+    }
+
+    return 0;
+}
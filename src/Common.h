@@ -100,6 +100,7 @@ struct GraphConfig{
     float voxel_size = 0.02;
     bool involve_floor_edge = false;
     std::string ignore_labels = "floor. carpet. ceiling.";
+    int triplet_seed = 0; // seed of the per-node corner sampler
 
     const std::string print_msg()const{
         std::stringstream msg;
@@ -107,6 +108,7 @@ struct GraphConfig{
         msg<<" - voxel_size: "<<voxel_size<<std::endl;
         msg<<" - involve_floor_edge: "<<involve_floor_edge<<std::endl;
         msg<<" - ignore_labels: "<<ignore_labels<<std::endl;
+        msg<<" - triplet_seed: "<<triplet_seed<<std::endl;
         return msg.str();
     }
 };
@@ -117,6 +119,13 @@ struct SgNetConfig
     int triplet_number=20; // number of triplets for each node
     int warm_up_iter=10;
     float instance_match_threshold=0.1;
+    std::string device = "cuda"; // cuda or cpu. Falls back to cpu if CUDA is unavailable
+    int intra_op_threads = 0; // 0 keeps the libtorch default
+    bool onednn_fusion = false; // oneDNN graph fusion, cpu only
+    int validation_level = 0; // 0: sanitize nan on device only, 1: also count and warn (host sync), 2: also assert
+    std::string label_embedding_cache = ""; // prefix of the BERT label embedding cache (.txt, .pt). Empty to disable
+    std::string tokenizer_cache_dir = ""; // directory to cache the preprocessed bert vocabulary. Empty to disable
+    bool profile_latency = false; // synchronize cuda after each module call, so the latency includes kernel time
     
     const std::string print_msg()const{
         std::stringstream msg;
@@ -124,6 +133,13 @@ struct SgNetConfig
         msg<<" - triplet_number: "<<triplet_number<<std::endl;
         msg<<" - warm_up_iter: "<<warm_up_iter<<std::endl;
         msg<<" - instance_match_threshold: "<<instance_match_threshold<<std::endl;
+        msg<<" - device: "<<device<<std::endl;
+        msg<<" - intra_op_threads: "<<intra_op_threads<<std::endl;
+        msg<<" - onednn_fusion: "<<onednn_fusion<<std::endl;
+        msg<<" - validation_level: "<<validation_level<<std::endl;
+        msg<<" - label_embedding_cache: "<<label_embedding_cache<<std::endl;
+        msg<<" - tokenizer_cache_dir: "<<tokenizer_cache_dir<<std::endl;
+        msg<<" - profile_latency: "<<profile_latency<<std::endl;
         return msg.str();
     }
 };
@@ -137,6 +153,7 @@ struct ShapeEncoderConfig
     int K_shape_samples = 1024;
     int K_match_samples = 512;
     std::string padding = "zero"; // zero, random
+    int sample_seed = 0; // seed of the per-node point sampler
 
     const std::string print_msg()const{
         std::stringstream msg;
@@ -147,6 +164,7 @@ struct ShapeEncoderConfig
         msg<<" - K_shape_samples: "<<K_shape_samples<<std::endl;
         msg<<" - K_match_samples: "<<K_match_samples<<std::endl;
         msg<<" - padding: "<<padding<<std::endl;
+        msg<<" - sample_seed: "<<sample_seed<<std::endl;
         return msg.str();
     }
 };
@@ -156,12 +174,14 @@ struct LoopDetectorConfig
     bool fuse_shape = false;
     int lcd_nodes = 12;
     int recall_nodes = 8;
+    float point_match_memory_mb = 4096; // memory budget of one point match chunk. 0 matches all pairs at once
 
     const std::string print_msg()const{
         std::stringstream msg;
         msg<<" - fuse_shape: "<<fuse_shape<<std::endl;
         msg<<" - lcd_nodes: "<<lcd_nodes<<std::endl;
         msg<<" - recall_nodes: "<<recall_nodes<<std::endl;
+        msg<<" - point_match_memory_mb: "<<point_match_memory_mb<<std::endl;
         return msg.str();
     }
 };
@@ -29,39 +29,42 @@ class BayesianLabel  // BayesianLabel 클래스 정의
         };
         ~BayesianLabel() {};  // 소멸자 정의
 
-        /// \brief 측정값으로부터 확률 벡터를 업데이트합니다.
-        bool update_measurements(const std::vector<LabelScore> &measurements,
-                                 Eigen::VectorXf &probability_vector)
+        /// \brief 측정값으로부터 확률 벡터를 업데이트합니다. 확률 벡터는 0으로 초기화된 뒤 누적됩니다.
+        template<typename MeasurementContainer>
+        bool update_measurements(const MeasurementContainer &measurements,
+                                 Eigen::VectorXf &probability_vector) const
         {
             if (measurements.empty() || !is_loaded) return false;  // 입력 값이 비어 있거나 로드되지 않은 경우 false 반환
+            if (probability_vector.size() != likelihood_matrix.cols())
+                probability_vector.resize(likelihood_matrix.cols());  // 크기가 다를 때만 재할당
+            probability_vector.setZero();  // 확률 벡터를 0으로 초기화
 
-            int rows = measurements.size();  // 측정값의 개수를 행 크기로 설정
-            int cols = predict_label_vec.size();  // 예측 레이블 벡터의 크기를 열 크기로 설정
-            probability_vector = Eigen::VectorXf::Zero(cols);  // 확률 벡터를 0으로 초기화
-            for (int i = 0; i < rows; i++) {
-                std::string measure_label = measurements[i].first;  // 측정 레이블 추출
-                float measure_score = measurements[i].second;  // 측정 점수 추출
-                if (measure_label_map.find(measure_label) != measure_label_map.end()) {
-                    probability_vector += measure_score 
-                                        * likelihood_matrix.row(measure_label_map[measure_label]).transpose();  
-                    // 해당 레이블의 likelihood 행을 점수로 가중치 계산하여 확률 벡터에 추가
-                }
-            }
-
-            return true;  // 업데이트 성공 반환
+            return accumulate_measurements(measurements, probability_vector);
         }
-        
-        /// \brief unordered_map 형식의 측정값을 업데이트합니다.
-        bool update_measurements(const std::unordered_map<std::string, float> &measurements,
-                                 Eigen::VectorXf &probability_vector)
+
+        /// \brief (라벨 ID, 점수) 희소 측정값과 likelihood 행렬의 곱을 확률 벡터에 누적합니다.
+        ///        확률 벡터는 인스턴스가 미리 할당한 버퍼이며, 이 함수는 메모리를 할당하지 않습니다.
+        /// \param measurements LabelIdScore 쌍을 순회할 수 있는 컨테이너 (vector, unordered_map 등)
+        /// \param probability_vector 크기가 get_num_classes()인 누적 버퍼
+        template<typename MeasurementContainer>
+        bool accumulate_measurements(const MeasurementContainer &measurements,
+                                     Eigen::VectorXf &probability_vector) const
         {
-            if (measurements.empty() || !is_loaded) return false;  // 입력 값이 비어 있거나 로드되지 않은 경우 false 반환
-            std::vector<LabelScore> measurements_vec;  // LabelScore 벡터로 변환
+            if (measurements.empty() || !is_loaded) return false;
+            if (probability_vector.size() != likelihood_matrix.cols()) {
+                std::cerr << "Probability vector size mismatch.\n";
+                return false;
+            }
+
             for (const auto &label_score : measurements) {
-                measurements_vec.emplace_back(std::make_pair(label_score.first, label_score.second));  // 벡터에 추가
+                if (label_score.first >= measure_label_rows.size()) continue;  // likelihood 로드 이후 새로 등록된 라벨
+                const int row = measure_label_rows[label_score.first];
+                if (row < 0) continue;  // likelihood 행렬에 없는 측정 레이블
+                probability_vector.noalias() += label_score.second * likelihood_matrix.row(row).transpose();
+                // 해당 레이블의 likelihood 행을 점수로 가중치 계산하여 확률 벡터에 추가
             }
 
-            return update_measurements(measurements_vec, probability_vector);  // 벡터 기반 업데이트 함수 호출
+            return true;  // 업데이트 성공 반환
         }
 
         /// \brief 예측 레이블 벡터를 반환합니다.
@@ -69,6 +72,11 @@ class BayesianLabel  // BayesianLabel 클래스 정의
             return predict_label_vec;
         }
 
+        /// \brief 예측 레이블 인덱스에 해당하는 레이블 이름을 반환합니다.
+        const std::string &get_label(int idx) const {
+            return predict_label_vec[idx];
+        }
+
         /// \brief 클래스의 총 개수를 반환합니다.
         int get_num_classes() const {
             return predict_label_vec.size();
@@ -93,7 +101,7 @@ class BayesianLabel  // BayesianLabel 클래스 정의
                 int rows = measure_label_vec.size();  // 측정 레이블 크기
                 int cols = predict_label_vec.size();  // 예측 레이블 크기
                 std::cout << "rows: " << rows << " cols: " << cols << std::endl;  // 행렬 크기 출력
-                likelihood_matrix = Eigen::MatrixXf::Zero(rows, cols);  // 0으로 초기화된 행렬 생성
+                likelihood_matrix = LikelihoodMatrix::Zero(rows, cols);  // 0으로 초기화된 행렬 생성
                 for (int i = 0; i < rows; i++) {
                     std::getline(file, line);  // 각 행 데이터 읽기
                     std::vector<std::string> values = utility::split_str(line, ",");  // 값으로 분리
@@ -104,7 +112,9 @@ class BayesianLabel  // BayesianLabel 클래스 정의
                 
                 msg << "Measured label-set: ";
                 for (int i = 0; i < measure_label_vec.size(); i++) {
-                    measure_label_map[measure_label_vec[i]] = i;  // 측정 레이블 맵에 저장
+                    LabelId label_id = LabelDict::intern(measure_label_vec[i]);  // 측정 레이블을 전역 사전에 등록
+                    if (label_id >= measure_label_rows.size()) measure_label_rows.resize(label_id + 1, -1);
+                    measure_label_rows[label_id] = i;  // 라벨 ID -> likelihood 행 인덱스
                     msg << measure_label_vec[i] << " ";
                 }
                 msg << "\nPredict label-set: ";
@@ -126,8 +136,11 @@ class BayesianLabel  // BayesianLabel 클래스 정의
         bool is_loaded = false;  // likelihood 행렬이 로드되었는지 여부
         std::vector<std::string> predict_label_vec;  // 예측 레이블 벡터
         std::vector<std::string> measure_label_vec;  // 측정 레이블 벡터
-        std::map<std::string, int> measure_label_map;  // 측정 레이블 맵
-        Eigen::MatrixXf likelihood_matrix;  // likelihood 행렬
+        std::vector<int> measure_label_rows;  // 라벨 ID로 인덱싱되는 likelihood 행 인덱스 (-1: 없음)
+
+        // 측정 레이블 한 개가 행 하나를 읽으므로 행 우선(row-major)으로 저장합니다.
+        typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> LikelihoodMatrix;
+        LikelihoodMatrix likelihood_matrix;  // likelihood 행렬
 };
 
 }
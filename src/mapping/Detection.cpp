@@ -9,6 +9,23 @@ Detection::Detection(const int id): id_(id)
     // Detection 클래스의 생성자에서 객체 ID를 초기화합니다.
 }
 
+Detection::Detection(const std::vector<LabelScore> &labels, const BoundingBox &bbox, const cv::Mat &instances_idxs):
+    bbox_(bbox), instances_idxs_(instances_idxs)
+{
+    labels_.reserve(labels.size());
+    label_ids_.reserve(labels.size());
+    for(const auto &label_score: labels){
+        add_label(label_score.first, label_score.second);
+    }
+}
+
+void Detection::add_label(const std::string &label, const float &score)
+{
+    // 라벨 문자열은 파싱 시점에 한 번만 ID로 변환합니다. 이후 융합 단계는 ID만 사용합니다.
+    labels_.emplace_back(label, score);
+    label_ids_.emplace_back(LabelDict::intern(label), score);
+}
+
 std::string Detection::extract_label_string() const
 {
     std::stringstream ss;  // 문자열을 처리하기 위한 스트림 객체 생성
@@ -77,7 +94,7 @@ bool DetectionFile::ConvertFromJsonValue(const Json::Value &value)
             // 레이블-점수 쌍을 순회
             std::string label = it.key().asString();  
             float score = (*it).asFloat();  
-            detection->labels_.push_back(std::make_pair(label, score));  
+            detection->add_label(label, score);  
             msg << "(" << label << "," << score << ") ";  
         }
 
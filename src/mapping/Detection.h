@@ -3,6 +3,7 @@
 
 #include "opencv2/opencv.hpp" // OpenCV 라이브러리 포함
 #include "open3d/utility/IJsonConvertible.h" // Open3D JSON 변환 유틸리티 포함
+#include "LabelDict.h" // 전역 라벨 사전 포함
 
 namespace fmfusion
 {
@@ -17,8 +18,9 @@ class Detection
 {
 public:
     Detection(const int id); // ID를 받아 Detection 객체를 초기화하는 생성자
-    Detection(const std::vector<LabelScore> &labels, const BoundingBox &bbox, const cv::Mat &instances_idxs): 
-        labels_(labels), bbox_(bbox), instances_idxs_(instances_idxs) {}; // 라벨, 바운딩 박스, 인스턴스 데이터를 이용한 생성자
+    Detection(const std::vector<LabelScore> &labels, const BoundingBox &bbox, const cv::Mat &instances_idxs); // 라벨, 바운딩 박스, 인스턴스 데이터를 이용한 생성자
+
+    void add_label(const std::string &label, const float &score); // 라벨을 등록하고 라벨 ID도 함께 기록하는 함수
 
     std::string extract_label_string() const; // 라벨 문자열을 추출하는 함수
     const cv::Point get_box_center(){return cv::Point((bbox_.u0+bbox_.u1)/2,(bbox_.v0+bbox_.v1)/2);}; // 바운딩 박스 중심 좌표 반환
@@ -27,6 +29,7 @@ public:
 public:
     unsigned int id_; // Detection 객체의 ID
     std::vector<LabelScore> labels_; // 라벨과 점수 리스트
+    std::vector<LabelIdScore> label_ids_; // labels_와 같은 순서의 라벨 ID와 점수 리스트
     BoundingBox bbox_; // 바운딩 박스 데이터
     cv::Mat instances_idxs_; // 인스턴스 인덱스 매트릭스 [H,W], CV_8UC1 타입
 };
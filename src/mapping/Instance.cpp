@@ -1,11 +1,12 @@
 #include "Instance.h" // Instance 클래스의 헤더 파일 포함
+#include "BayesianLabel.h" // 베이지안 라벨 모델 포함
 
 namespace fmfusion { // fmfusion 네임스페이스 정의
 
     // Instance 클래스 생성자 정의
     Instance::Instance(const InstanceId id, const unsigned int frame_id, const InstanceConfig &config) :
             id_(id), frame_id_(frame_id), update_frame_id(frame_id), 
-            config_(config), bayesian_label(false) 
+            config_(config), bayesian_model(nullptr), bayesian_label(false) 
     {
         // SubVolume 객체 생성 및 초기화
         volume_ = new SubVolume(config_.voxel_length, config_.sdf_trunc,
@@ -30,10 +31,10 @@ namespace fmfusion { // fmfusion 네임스페이스 정의
     }
 
     // 베이지안 융합 초기화 함수
-    void Instance::init_bayesian_fusion(const std::vector<std::string> &label_set)
+    void Instance::init_bayesian_fusion(const BayesianLabel *bayesian_model_)
     {
-        semantic_labels = std::vector<std::string>(label_set); // 라벨 리스트 설정
-        probability_vector = Eigen::VectorXf::Zero(label_set.size()); // 확률 벡터 초기화
+        bayesian_model = bayesian_model_; // 공유 모델 설정
+        probability_vector = Eigen::VectorXf::Zero(bayesian_model->get_num_classes()); // 확률 벡터 초기화
         bayesian_label = true; // 베이지안 라벨 활성화
     }
 
@@ -147,21 +148,17 @@ namespace fmfusion { // fmfusion 네임스페이스 정의
 
     // 포인트 클라우드 병합 함수
     void Instance::merge_with(const O3d_Cloud_Ptr &other_cloud,
-                              const std::unordered_map<std::string, float> &label_measurements,
+                              const LabelSet &label_measurements,
                               const int &observations_) {
         *merged_cloud += *other_cloud; // 다른 포인트 클라우드 병합
         merged_cloud->VoxelDownSample(config_.voxel_length); // 다운샘플링
         merged_cloud->PaintUniformColor(color_); // 병합된 클라우드에 색상 적용
 
-        for (const auto label_score : label_measurements) { // 라벨 점수 갱신
-            if (measured_labels.find(label_score.first) == measured_labels.end()) {
-                measured_labels[label_score.first] = label_score.second;
-            } else {
-                measured_labels[label_score.first] += label_score.second;
-            }
+        for (const auto &label_score : label_measurements) { // 라벨 점수 갱신
+            float accumulated_score = measured_labels.add(label_score.first, label_score.second);
 
-            if (!bayesian_label && measured_labels[label_score.first] > predicted_label.second) {
-                predicted_label = std::make_pair(label_score.first, measured_labels[label_score.first]); // 예측 라벨 업데이트
+            if (!bayesian_label && accumulated_score > predicted_label.second) {
+                predicted_label = std::make_pair(LabelDict::name(label_score.first), accumulated_score); // 예측 라벨 업데이트
             }
         }
         observation_count += observations_; // 관측 횟수 증가
@@ -170,28 +167,27 @@ namespace fmfusion { // fmfusion 네임스페이스 정의
     }
 
     // 의미 확률 벡터 업데이트 함수
-    bool Instance::update_semantic_probability(const Eigen::VectorXf &probability_vector_) {
-        if (probability_vector_.size() != probability_vector.size()) { // 크기 확인
-            std::cerr << "Probability vector size mismatch.\n";
-            return false;
-        } else {
-            probability_vector += probability_vector_; // 확률 벡터 갱신
-            extract_bayesian_prediciton(); // 베이지안 예측 갱신
-            return true;
-        }
+    bool Instance::update_semantic_probability(const std::vector<LabelIdScore> &label_measurements) {
+        if (!bayesian_label) return false;
+        if (!bayesian_model->accumulate_measurements(label_measurements, probability_vector)) return false; // 확률 벡터 갱신
+        extract_bayesian_prediciton(); // 베이지안 예측 갱신
+        return true;
+    }
+
+    bool Instance::update_semantic_probability(const LabelSet &label_measurements) {
+        if (!bayesian_label) return false;
+        if (!bayesian_model->accumulate_measurements(label_measurements, probability_vector)) return false; // 확률 벡터 갱신
+        extract_bayesian_prediciton(); // 베이지안 예측 갱신
+        return true;
     }
 
     // 라벨 업데이트 함수
     void Instance::update_label(const DetectionPtr &detection) {
-        for (const auto &label_score : detection->labels_) {
-            if (measured_labels.find(label_score.first) == measured_labels.end()) {
-                measured_labels[label_score.first] = label_score.second;
-            } else {
-                measured_labels[label_score.first] += label_score.second;
-            }
+        for (const auto &label_score : detection->label_ids_) {
+            float accumulated_score = measured_labels.add(label_score.first, label_score.second);
 
-            if (!bayesian_label && measured_labels[label_score.first] > predicted_label.second) {
-                predicted_label = std::make_pair(label_score.first, measured_labels[label_score.first]); // 예측 라벨 업데이트
+            if (!bayesian_label && accumulated_score > predicted_label.second) {
+                predicted_label = std::make_pair(LabelDict::name(label_score.first), accumulated_score); // 예측 라벨 업데이트
             }
         }
         observation_count++; // 관측 횟수 증가
@@ -201,9 +197,10 @@ namespace fmfusion { // fmfusion 네임스페이스 정의
     void Instance::extract_bayesian_prediciton() {
         if (bayesian_label) {
             int max_idx;
-            probability_vector.maxCoeff(&max_idx); // 최대 확률 라벨 찾기
-            Eigen::VectorXf probability_normalized = probability_vector.normalized(); // 확률 정규화
-            predicted_label = std::make_pair(semantic_labels[max_idx], probability_normalized[max_idx]); // 예측 라벨 설정
+            float max_probability = probability_vector.maxCoeff(&max_idx); // 최대 확률 라벨 찾기
+            float norm = probability_vector.norm(); // 정규화 벡터를 만들지 않고 노름만 계산
+            predicted_label = std::make_pair(bayesian_model->get_label(max_idx),
+                                             norm > 0.0f ? max_probability / norm : 0.0f); // 예측 라벨 설정
         } else {
             std::cerr << "Instance " << id_ << " is not in Bayesian fusion mode.\n";
         }
@@ -249,7 +246,7 @@ namespace fmfusion { // fmfusion 네임스페이스 정의
             float score;
             std::getline(ss2, label, '('); // 라벨 이름 추출
             ss2 >> score; // 점수 추출
-            measured_labels[label] = score; // 라벨 점수 저장
+            measured_labels.add(LabelDict::intern(label), score); // 라벨 점수 저장
             if (score > predicted_label.second) { // 예측 라벨 갱신
                 predicted_label = std::make_pair(label, score);
             }
@@ -11,6 +11,8 @@
 
 namespace fmfusion { // fmfusion 네임스페이스 정의
 
+    class BayesianLabel; // 베이지안 라벨 모델 (BayesianLabel.h)
+
     namespace o3d_utility = open3d::utility; // Open3D 유틸리티를 별칭으로 정의
 
     // Instance 클래스 정의
@@ -23,8 +25,8 @@ namespace fmfusion { // fmfusion 네임스페이스 정의
         // Instance 클래스 소멸자
         ~Instance() {};
 
-        // 베이지안 융합 초기화 함수
-        void init_bayesian_fusion(const std::vector<std::string> &label_set);
+        // 베이지안 융합 초기화 함수. 모델은 모든 인스턴스가 공유하며, 확률 벡터 버퍼만 인스턴스별로 할당합니다.
+        void init_bayesian_fusion(const BayesianLabel *bayesian_model_);
 
     public:
         // TSDF 볼륨에 데이터를 통합하는 함수
@@ -40,12 +42,13 @@ namespace fmfusion { // fmfusion 네임스페이스 정의
         // 포인트 클라우드를 업데이트하는 함수
         bool update_point_cloud(int cur_frame_id, int min_frame_gap = 10);
 
-        // 베이지안 라벨에서 확률 벡터를 업데이트하는 함수
-        bool update_semantic_probability(const Eigen::VectorXf &probability_vector_);
+        // 라벨 측정값을 확률 벡터 버퍼에 직접 누적하는 함수
+        bool update_semantic_probability(const std::vector<LabelIdScore> &label_measurements);
+        bool update_semantic_probability(const LabelSet &label_measurements);
 
         // 포인트 클라우드 병합 함수
         void merge_with(const O3d_Cloud_Ptr &other_cloud,
-                        const std::unordered_map<std::string, float> &label_measurements, 
+                        const LabelSet &label_measurements, 
                         const int &observations_);
 
         // 포인트 클라우드 추출 및 저장 함수
@@ -79,12 +82,12 @@ namespace fmfusion { // fmfusion 네임스페이스 정의
         SubVolume *get_volume() { return volume_; }
 
         // 예측된 클래스 반환 함수
-        LabelScore get_predicted_class() const { 
+        const LabelScore &get_predicted_class() const { 
             return predicted_label;
         }
 
-        // 측정된 라벨 반환 함수
-        std::unordered_map<std::string, float> get_measured_labels() const { 
+        // 측정된 라벨 반환 함수 (복사 없이 참조 반환)
+        const LabelSet &get_measured_labels() const { 
             return measured_labels; 
         }
 
@@ -101,7 +104,7 @@ namespace fmfusion { // fmfusion 네임스페이스 정의
         std::string get_measured_labels_string() const {
             std::stringstream label_measurements;
             for (const auto &label_score: measured_labels) {
-                label_measurements << label_score.first
+                label_measurements << LabelDict::name(label_score.first)
                                    << "(" << std::fixed << std::setprecision(2) << label_score.second << "),";
             }
             return label_measurements.str();
@@ -144,14 +147,14 @@ namespace fmfusion { // fmfusion 네임스페이스 정의
     private:
         InstanceId id_; // 인스턴스 ID (1 이상)
         InstanceConfig config_; // 인스턴스 구성 설정
-        std::unordered_map<std::string, float> measured_labels; // 측정된 라벨
+        LabelSet measured_labels; // 측정된 라벨 (라벨 ID 순 정렬, 누적 점수)
         LabelScore predicted_label; // 예측된 라벨
         int observation_count; // 관측 횟수
         O3d_Cloud_Ptr merged_cloud; // 병합된 포인트 클라우드
 
         // 베이지안 융합을 위한 설정
-        std::vector<std::string> semantic_labels; // 의미 라벨 리스트
-        Eigen::VectorXf probability_vector; // 확률 벡터
+        const BayesianLabel *bayesian_model; // 공유 베이지안 라벨 모델
+        Eigen::VectorXf probability_vector; // 확률 벡터 (init_bayesian_fusion에서 한 번 할당)
         bool bayesian_label; // 베이지안 라벨 여부
     };
 
@@ -0,0 +1,173 @@
+#ifndef FMFUSION_LABELDICT_H
+#define FMFUSION_LABELDICT_H
+
+#include <algorithm> // lower_bound, min_element
+#include <array> // 고정 용량 배열
+#include <cstdint> // 고정 크기 정수 타입
+#include <deque> // 라벨 이름 저장 (참조 안정성 보장)
+#include <mutex> // 다중 쓰레드 접근 보호
+#include <string> // 문자열 처리를 위한 헤더 파일
+#include <unordered_map> // 해시 맵을 사용하기 위한 헤더 파일
+
+namespace fmfusion
+{
+    typedef uint32_t LabelId; // 전역 라벨 ID (0부터 순차적으로 부여)
+    typedef std::pair<LabelId,float> LabelIdScore; // 라벨 ID와 점수의 쌍
+
+    /// \brief 라벨 문자열을 밀집(dense) 정수 ID로 변환하는 전역 사전.
+    ///        ID는 추가만 되고 삭제되지 않으므로, 한 번 부여된 ID는 프로세스 수명 동안 유효합니다.
+    class LabelDict
+    {
+    public:
+        static const LabelId UNSET = 0xFFFFFFFF; // 라벨이 아직 지정되지 않았음을 나타내는 ID (사전에 등록되지 않음)
+
+        /// \brief 라벨을 등록하고 ID를 반환합니다. 이미 등록된 라벨이면 기존 ID를 반환합니다.
+        static LabelId intern(const std::string &label)
+        {
+            LabelDict &dict = instance();
+            std::lock_guard<std::mutex> lock(dict.mtx);
+            auto it = dict.label2id.find(label);
+            if (it != dict.label2id.end()) return it->second;
+
+            LabelId id = dict.id2label.size();
+            dict.id2label.emplace_back(label);
+            dict.label2id.emplace(label, id);
+            return id;
+        }
+
+        /// \brief 등록된 라벨의 ID를 찾습니다. 등록되지 않은 라벨이면 false를 반환합니다.
+        static bool find(const std::string &label, LabelId &id)
+        {
+            LabelDict &dict = instance();
+            std::lock_guard<std::mutex> lock(dict.mtx);
+            auto it = dict.label2id.find(label);
+            if (it == dict.label2id.end()) return false;
+            id = it->second;
+            return true;
+        }
+
+        /// \brief ID에 해당하는 라벨 문자열을 반환합니다.
+        static const std::string &name(const LabelId &id)
+        {
+            LabelDict &dict = instance();
+            std::lock_guard<std::mutex> lock(dict.mtx);
+            return dict.id2label.at(id);
+        }
+
+        /// \brief 등록된 라벨의 개수를 반환합니다.
+        static size_t size()
+        {
+            LabelDict &dict = instance();
+            std::lock_guard<std::mutex> lock(dict.mtx);
+            return dict.id2label.size();
+        }
+
+    private:
+        LabelDict() {};
+
+        static LabelDict &instance()
+        {
+            static LabelDict dict;
+            return dict;
+        }
+
+    private:
+        std::mutex mtx;
+        std::unordered_map<std::string, LabelId> label2id; // 라벨 -> ID
+        std::deque<std::string> id2label; // ID -> 라벨
+    };
+
+    /// \brief 인스턴스별 측정 라벨 집합. 라벨 ID 순으로 정렬된 고정 용량 배열과 64비트 라벨 서명을 유지합니다.
+    ///        서명의 비트 AND로 공통 라벨이 없는 쌍을 바로 걸러내고, 남은 쌍만 정렬 병합으로 확인합니다.
+    class LabelSet
+    {
+    public:
+        static const int CAPACITY = 32; // 인스턴스당 최대 측정 라벨 수
+        typedef const LabelIdScore *const_iterator;
+
+        LabelSet(): count(0), signature(0) {};
+
+        /// \brief 라벨 점수를 누적하고 누적된 점수를 반환합니다.
+        ///        용량이 가득 찬 경우, 새 점수가 더 높을 때만 가장 낮은 점수의 라벨을 대체합니다.
+        float add(const LabelId &id, const float &score)
+        {
+            LabelIdScore *first = entries.data();
+            LabelIdScore *last = first + count;
+            LabelIdScore *it = std::lower_bound(first, last, id,
+                [](const LabelIdScore &a, const LabelId &b){return a.first < b;});
+            if (it != last && it->first == id) {
+                it->second += score;
+                return it->second;
+            }
+
+            if (count == CAPACITY) {
+                LabelIdScore *weakest = std::min_element(first, last,
+                    [](const LabelIdScore &a, const LabelIdScore &b){return a.second < b.second;});
+                if (weakest->second >= score) return 0.0f;
+                std::move(weakest + 1, last, weakest); // 가장 약한 라벨 제거
+                count--;
+                rebuild_signature();
+                return add(id, score);
+            }
+
+            std::move_backward(it, last, last + 1); // 정렬 순서를 유지하며 삽입
+            *it = std::make_pair(id, score);
+            count++;
+            signature |= bit(id);
+            return score;
+        }
+
+        /// \brief 다른 라벨 집합의 점수를 모두 누적합니다.
+        void merge(const LabelSet &other)
+        {
+            for (const auto &label_score : other) add(label_score.first, label_score.second);
+        }
+
+        /// \brief 라벨의 누적 점수를 찾습니다.
+        bool find(const LabelId &id, float &score) const
+        {
+            if ((signature & bit(id)) == 0) return false;
+            const LabelIdScore *it = std::lower_bound(begin(), end(), id,
+                [](const LabelIdScore &a, const LabelId &b){return a.first < b;});
+            if (it == end() || it->first != id) return false;
+            score = it->second;
+            return true;
+        }
+
+        /// \brief 두 라벨 집합에 공통 라벨이 있는지 확인합니다.
+        bool intersects(const LabelSet &other) const
+        {
+            if ((signature & other.signature) == 0) return false; // 공통 비트가 없으면 공통 라벨도 없음
+            const_iterator a = begin(), b = other.begin();
+            while (a != end() && b != other.end()) { // 서명 충돌을 배제하기 위한 정렬 병합
+                if (a->first == b->first) return true;
+                if (a->first < b->first) a++;
+                else b++;
+            }
+            return false;
+        }
+
+        const_iterator begin() const { return entries.data(); }
+        const_iterator end() const { return entries.data() + count; }
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        void clear() { count = 0; signature = 0; }
+
+    private:
+        static uint64_t bit(const LabelId &id) { return uint64_t(1) << (id & 63); }
+
+        void rebuild_signature()
+        {
+            signature = 0;
+            for (const auto &label_score : *this) signature |= bit(label_score.first);
+        }
+
+    private:
+        std::array<LabelIdScore, CAPACITY> entries; // 라벨 ID 오름차순
+        int count; // 유효한 라벨 수
+        uint64_t signature; // 라벨 ID 비트 서명 (id mod 64)
+    };
+
+}
+
+#endif // FMFUSION_LABELDICT_H
@@ -1,14 +1,20 @@
 #ifndef SEMANTICDICT_H
 #define SEMANTICDICT_H
 
+#include <algorithm> // 인스턴스 ID 검색을 위한 헤더 파일
 #include <unordered_map> // 해시 맵을 사용하기 위한 헤더 파일
+#include <vector> // 인스턴스 ID 리스트
+
+#include "LabelDict.h" // 전역 라벨 사전 포함
 
 namespace fmfusion // fmfusion 네임스페이스 정의
 {
-    // SemanticDictionary 타입 정의: 문자열 키와 InstanceId 리스트를 값으로 가지는 해시 맵
-    typedef std::unordered_map<std::string, InstanceIdList> SemanticDictionary;
+    // SemanticDictionary 타입 정의: 라벨 ID 키와 InstanceId 리스트를 값으로 가지는 해시 맵 (역색인)
+    typedef std::unordered_map<LabelId, InstanceIdList> SemanticDictionary;
 
     // SemanticDictServer 클래스 정의
+    // 모든 예측 라벨에 대해 라벨 -> 인스턴스 역색인을 유지합니다.
+    // 인스턴스 생성, 병합, 라벨 변경, 삭제 시점에 점진적으로 갱신됩니다.
     class SemanticDictServer
     {
     public:
@@ -21,43 +27,83 @@ namespace fmfusion // fmfusion 네임스페이스 정의
         // 소멸자: 현재는 특별히 할 작업 없음
         ~SemanticDictServer(){};
 
-        /// @brief 의미 체계를 업데이트하는 함수
+        /// @brief 인스턴스의 의미 라벨을 등록하거나 갱신하는 함수. 라벨이 바뀐 경우 이전 라벨에서 제거됩니다.
         /// @param semantic_label 의미 라벨
         /// @param instance_id 인스턴스 ID
-        void update_instance(const std::string &semantic_label, 
+        void update_instance(const std::string &semantic_label,
                             const InstanceId &instance_id)
         {
-            // 의미 라벨이 "floor" 또는 "carpet"인 경우 처리
-            if(semantic_label=="floor" || semantic_label=="carpet"){
-                if(semantic_dict.find(semantic_label) == semantic_dict.end()) // 라벨이 없으면 새로 추가
-                    semantic_dict[semantic_label] = {instance_id};
-                else // 라벨이 이미 있으면 인스턴스 ID 추가
-                    semantic_dict[semantic_label].push_back(instance_id);
+            LabelId label_id = LabelDict::intern(semantic_label);
+            auto it = instance_labels.find(instance_id);
+            if(it != instance_labels.end()){
+                if(it->second == label_id) return; // 라벨 변경 없음
+                erase_from_list(it->second, instance_id); // 이전 라벨에서 제거
+                it->second = label_id;
             }
+            else instance_labels.emplace(instance_id, label_id);
+
+            semantic_dict[label_id].push_back(instance_id);
         };
 
+        /// @brief 삭제된 인스턴스를 역색인에서 제거하는 함수
+        void remove_instance(const InstanceId &instance_id)
+        {
+            auto it = instance_labels.find(instance_id);
+            if(it == instance_labels.end()) return;
+            erase_from_list(it->second, instance_id);
+            instance_labels.erase(it);
+        }
+
         // semantic_dict를 비우는 함수
         void clear()
         {
-            semantic_dict.clear();  
+            semantic_dict.clear();
+            instance_labels.clear();
         };
 
         // 특정 라벨에 해당하는 인스턴스 ID 리스트를 반환하는 함수
-        std::vector<InstanceId> query_instances(const std::string &label)
+        std::vector<InstanceId> query_instances(const std::string &label) const
         {
-            if(semantic_dict.find(label) == semantic_dict.end()) // 라벨이 없으면 빈 리스트 반환
-                return {};
-            return semantic_dict[label]; // 라벨이 있으면 해당 인스턴스 리스트 반환
+            LabelId label_id;
+            if(!LabelDict::find(label, label_id)) return {}; // 등록되지 않은 라벨이면 빈 리스트 반환
+            auto it = semantic_dict.find(label_id);
+            if(it == semantic_dict.end()) return {};
+            return it->second; // 라벨이 있으면 해당 인스턴스 리스트 반환
         }
 
-        // semantic_dict를 반환하는 함수 (주석 처리됨)
-        // SemanticDictionary get_semantic_dict()
-        // {
-        //     return semantic_dict;
-        // }
+        // 라벨 집합 중 하나에 해당하는 인스턴스 ID 리스트를 반환하는 함수
+        std::vector<InstanceId> query_label_set(const std::vector<std::string> &labels) const
+        {
+            std::vector<InstanceId> instances;
+            for(const auto &label: labels){
+                LabelId label_id;
+                if(!LabelDict::find(label, label_id)) continue;
+                auto it = semantic_dict.find(label_id);
+                if(it == semantic_dict.end()) continue;
+                instances.insert(instances.end(), it->second.begin(), it->second.end());
+            }
+            return instances;
+        }
+
+        // 등록된 인스턴스 수를 반환하는 함수
+        size_t size() const { return instance_labels.size(); }
+
+    private:
+        void erase_from_list(const LabelId &label_id, const InstanceId &instance_id)
+        {
+            auto dict_it = semantic_dict.find(label_id);
+            if(dict_it == semantic_dict.end()) return;
+            InstanceIdList &instances = dict_it->second;
+            auto it = std::find(instances.begin(), instances.end(), instance_id);
+            if(it == instances.end()) return;
+            *it = instances.back(); // 순서를 유지할 필요가 없으므로 마지막 원소와 교체 후 제거
+            instances.pop_back();
+            if(instances.empty()) semantic_dict.erase(dict_it);
+        }
 
     private:
-        SemanticDictionary semantic_dict; // 의미 체계 딕셔너리
+        SemanticDictionary semantic_dict; // 의미 체계 딕셔너리 (라벨 -> 인스턴스)
+        std::unordered_map<InstanceId, LabelId> instance_labels; // 인스턴스 -> 현재 등록된 라벨
     };
 
 }
@@ -108,6 +108,7 @@ void SemanticMapping::update_recent_instances(const int &frame_id,
         if ((frame_id - inst->second->frame_id_) > mapping_config.recent_window_size) {
             // 재관측되지 않고 포인트 클라우드가 없는 인스턴스를 제거
             if (!inst->second->point_cloud->HasPoints()) {
+                semantic_dict_server.remove_instance(idx);  // 세맨틱 사전에서 삭제
                 instance_map.erase(inst);  // 인스턴스 맵에서 삭제
             }
         }
@@ -204,16 +205,46 @@ int SemanticMapping::data_association(const std::vector<DetectionPtr> &detection
 
 void SemanticMapping::refresh_all_semantic_dict()
 {
-    // 세맨틱 사전 서버 초기화
+    // 세맨틱 사전은 생성/병합/삭제 시 점진적으로 갱신됩니다.
+    // 이 함수는 매핑 외부에서 예측 라벨이 바뀐 경우를 위해 사전을 전체 재동기화합니다.
     semantic_dict_server.clear();
 
     // 모든 인스턴스를 순회하며 세맨틱 사전 업데이트
-    for (auto instance : instance_map) {
-        auto instance_labels = instance.second->get_predicted_class();  // 예측된 클래스 레이블 가져오기
-        semantic_dict_server.update_instance(instance_labels.first, instance.first);  // 레이블과 인스턴스 ID를 업데이트
+    for (const auto &instance : instance_map) {
+        update_semantic_dict(instance.second);
     }
 }
 
+void SemanticMapping::update_semantic_dict(const InstancePtr &instance)
+{
+    // 예측된 클래스 레이블로 역색인 갱신. 라벨이 바뀌지 않았다면 아무 작업도 하지 않음
+    semantic_dict_server.update_instance(instance->get_predicted_class().first, instance->get_id());
+}
+
+void SemanticMapping::erase_instance(const InstanceId &instance_id)
+{
+    semantic_dict_server.remove_instance(instance_id);  // 역색인에서 제거
+    instance_map.erase(instance_id);  // 인스턴스 맵에서 제거
+}
+
+std::vector<InstanceId> SemanticMapping::query_semantic_instances(const std::vector<std::string> &labels,
+                                                                  const Eigen::Vector3d &center,
+                                                                  const double radius) const
+{
+    std::vector<InstanceId> candidates = semantic_dict_server.query_label_set(labels);
+    if (radius < 0.0) return candidates;  // 반경이 없으면 라벨 질의 결과만 반환
+
+    // 라벨 후보 중에서 중심이 반경 안에 있는 인스턴스만 선택
+    std::vector<InstanceId> instances;
+    const double radius_sq = radius * radius;
+    for (const auto &idx : candidates) {
+        auto it = instance_map.find(idx);
+        if (it == instance_map.end()) continue;
+        if ((it->second->centroid - center).squaredNorm() < radius_sq) instances.emplace_back(idx);
+    }
+    return instances;
+}
+
 int SemanticMapping::create_new_instance(const DetectionPtr &detection, const unsigned int &frame_id,
     const std::shared_ptr<open3d::geometry::RGBDImage> &rgbd_image, const Eigen::Matrix4d &pose)
 {
@@ -234,14 +265,13 @@ int SemanticMapping::create_new_instance(const DetectionPtr &detection, const un
 
     // 베이지안 라벨링이 활성화된 경우 확률 초기화 및 업데이트
     if (bayesian_label) {
-        Eigen::VectorXf probability_vector;  // 확률 벡터 초기화
-        instance->init_bayesian_fusion(bayesian_label->get_label_vec());  // 베이지안 융합 초기화
-        bayesian_label->update_measurements(detection->labels_, probability_vector);  // 측정 업데이트
-        instance->update_semantic_probability(probability_vector);  // 세맨틱 확률 업데이트
+        instance->init_bayesian_fusion(bayesian_label);  // 베이지안 융합 초기화
+        instance->update_semantic_probability(detection->label_ids_);  // 세맨틱 확률 업데이트
     }
 
-    // 새 인스턴스를 인스턴스 맵에 추가
+    // 새 인스턴스를 인스턴스 맵과 세맨틱 사전에 추가
     instance_map.emplace(instance->get_id(), instance);
+    update_semantic_dict(instance);
 
     // 최근 생성된 인스턴스 ID 업데이트
     latest_created_instance_id = instance->get_id();
@@ -251,19 +281,14 @@ int SemanticMapping::create_new_instance(const DetectionPtr &detection, const un
 }
 
 bool SemanticMapping::IsSemanticSimilar(
-    const std::unordered_map<std::string, float> &measured_labels_a,
-    const std::unordered_map<std::string, float> &measured_labels_b)
+    const LabelSet &measured_labels_a,
+    const LabelSet &measured_labels_b)
 {
     // 하나 이상의 레이블이 없는 경우 유사성 없음
     if (measured_labels_a.empty() || measured_labels_b.empty()) return false;
 
-    // 두 레이블 맵에서 공통 레이블 확인
-    for (const auto &label_score_a : measured_labels_a) {
-        for (const auto &label_score_b : measured_labels_b) {
-            if (label_score_a.first == label_score_b.first) return true;  // 공통 레이블 발견 시 true 반환
-        }
-    }
-    return false;  // 공통 레이블이 없으면 false 반환
+    // 라벨 서명의 비트 AND 후, 정렬된 라벨 ID를 병합하여 공통 레이블 확인
+    return measured_labels_a.intersects(measured_labels_b);
 }
 
 double SemanticMapping::Compute2DIoU(
@@ -395,10 +420,9 @@ int SemanticMapping::merge_overlap_instances(std::vector<InstanceId> instance_li
                     small_instance->get_observation_count());
 
                 if (bayesian_label) {
-                    Eigen::VectorXf probability_vector;
-                    bayesian_label->update_measurements(small_instance->get_measured_labels(), probability_vector);
-                    large_instance->update_semantic_probability(probability_vector);
+                    large_instance->update_semantic_probability(small_instance->get_measured_labels());
                 }
+                update_semantic_dict(large_instance);  // 병합으로 라벨이 바뀔 수 있음
 
                 remove_instances.insert(small_instance->get_id());  // 병합된 인스턴스 추가
                 if (small_instance->get_id() == instance_i->get_id()) break;  // 병합 완료 시 종료
@@ -408,7 +432,7 @@ int SemanticMapping::merge_overlap_instances(std::vector<InstanceId> instance_li
 
     // 병합된 인스턴스 제거
     for (auto &instance_id : remove_instances) {
-        instance_map.erase(instance_id);
+        erase_instance(instance_id);
     }
     timer.Stop();  // 타이머 종료
 
@@ -423,11 +447,7 @@ int SemanticMapping::merge_overlap_instances(std::vector<InstanceId> instance_li
 int SemanticMapping::merge_floor(bool verbose)
 {
     // "floor"와 "carpet" 레이블의 인스턴스를 대상으로 설정
-    std::vector<InstanceId> target_instances = semantic_dict_server.query_instances("floor");
-    std::vector<InstanceId> carpet_instances = semantic_dict_server.query_instances("carpet");
-    for (auto &carpet_id : carpet_instances) {
-        target_instances.emplace_back(carpet_id);
-    }
+    std::vector<InstanceId> target_instances = semantic_dict_server.query_label_set({"floor", "carpet"});
 
     // 병합 대상 인스턴스가 2개 미만인 경우 종료
     if (target_instances.size() < 2) return 0;
@@ -482,19 +502,17 @@ int SemanticMapping::merge_floor(bool verbose)
                 instance->get_observation_count());
 
             if (bayesian_label) {
-                Eigen::VectorXf probability_vector;
-                bayesian_label->update_measurements(instance->get_measured_labels(),
-                                                    probability_vector);
-                root_floor->update_semantic_probability(probability_vector);
+                root_floor->update_semantic_probability(instance->get_measured_labels());
             }
 
-            instance_map.erase(instance->get_id());  // 병합된 인스턴스 제거
+            erase_instance(instance->get_id());  // 병합된 인스턴스 제거
             count++;  // 병합된 인스턴스 수 증가
         }
 
         debug++;  // 확인한 인스턴스 수 증가
     }
 
+    if (count > 0) update_semantic_dict(root_floor);
     if (verbose) std::cout << debug << " floor instances are checked\n";
 
     // 병합 결과 출력
@@ -509,11 +527,7 @@ int SemanticMapping::merge_overlap_structural_instances(bool merge_all)
     assert(false);  // 사용 중단된 코드
 
     // "floor" 레이블을 가진 인스턴스 목록 생성
-    std::vector<InstanceId> target_instances;
-    for (auto &instance_j : instance_map) {
-        if (instance_j.second->get_predicted_class().first == "floor")
-            target_instances.emplace_back(instance_j.first);
-    }
+    std::vector<InstanceId> target_instances = semantic_dict_server.query_instances("floor");
 
     // 병합 대상 인스턴스가 2개 미만이면 병합 수행하지 않음
     if (target_instances.size() < 2) return 0;
@@ -540,7 +554,7 @@ int SemanticMapping::merge_overlap_structural_instances(bool merge_all)
                 instance->point_cloud,
                 instance->get_measured_labels(),
                 instance->get_observation_count());
-            instance_map.erase(idx);  // 병합된 인스턴스 제거
+            erase_instance(idx);  // 병합된 인스턴스 제거
         }
 
         // 병합된 인스턴스 수 반환
@@ -588,7 +602,7 @@ int SemanticMapping::merge_overlap_structural_instances(bool merge_all)
 
     // 병합된 인스턴스 제거
     for (auto &instance_id : remove_instances) {
-        instance_map.erase(instance_id);
+        erase_instance(instance_id);
     }
 
     // 병합된 인스턴스 수 반환 (이 섹션에서는 반환값이 명확하지 않음)
@@ -618,12 +632,11 @@ int SemanticMapping::merge_ambiguous_instances(const std::vector<std::pair<Insta
 
                 // 베이지안 라벨링 업데이트
                 if (bayesian_label) {
-                    Eigen::VectorXf probability_vector;
-                    bayesian_label->update_measurements(instance_j->get_measured_labels(), probability_vector);
-                    instance_i->update_semantic_probability(probability_vector);
+                    instance_i->update_semantic_probability(instance_j->get_measured_labels());
                 }
+                update_semantic_dict(instance_i);  // 병합으로 라벨이 바뀔 수 있음
 
-                instance_map.erase(pair.second);  // 병합된 인스턴스 제거
+                erase_instance(pair.second);  // 병합된 인스턴스 제거
                 count++;  // 병합된 인스턴스 수 증가
             }
         }
@@ -781,7 +794,7 @@ bool SemanticMapping::Save(const std::string &path)
     for (const auto &instance : instance_map) {
         if (!instance.second->point_cloud) continue;  // 유효하지 않은 점 클라우드 무시
 
-        LabelScore semantic_class_score = instance.second->get_predicted_class();  // 클래스 정보
+        const LabelScore &semantic_class_score = instance.second->get_predicted_class();  // 클래스 정보
         auto instance_cloud = instance.second->get_complete_cloud();  // 전체 클라우드 가져오기
 
         // 포인트 개수가 최소 기준 미만인 경우 무시
@@ -895,14 +908,13 @@ bool SemanticMapping::load(const std::string &path)
 
         // 베이지안 라벨링 활성화 시 초기화 및 확률 업데이트
         if (bayesian_label) {
-            Eigen::VectorXf probability_vector;
-            instance_toadd->init_bayesian_fusion(bayesian_label->get_label_vec());
-            bayesian_label->update_measurements(instance_toadd->get_measured_labels(), probability_vector);
-            instance_toadd->update_semantic_probability(probability_vector);
+            instance_toadd->init_bayesian_fusion(bayesian_label);
+            instance_toadd->update_semantic_probability(instance_toadd->get_measured_labels());
         }
 
-        // 인스턴스 맵에 추가
+        // 인스턴스 맵과 세맨틱 사전에 추가
         instance_map.emplace(instance_id, instance_toadd);
+        update_semantic_dict(instance_toadd);
     }
 
     // 로드된 인스턴스 수 로그 출력
@@ -967,6 +979,7 @@ int SemanticMapping::merge_other_instances(std::vector<InstancePtr> &instances)
 
         // 인스턴스 맵에 추가
         instance_map.emplace(instance->get_id(), instance);
+        update_semantic_dict(instance);
         latest_created_instance_id = instance->get_id();  // 최신 생성된 ID 갱신
         count++;
     }
@@ -50,6 +50,11 @@ namespace fmfusion {  // fmfusion 네임스페이스 정의
         // 모든 데이터와 사전을 새로고침합니다.
         void refresh_all_semantic_dict();
 
+        // 라벨 집합에 해당하는 인스턴스를 질의합니다. radius가 0 이상이면 center로부터 반경 안의 인스턴스만 반환합니다.
+        std::vector<InstanceId> query_semantic_instances(const std::vector<std::string> &labels,
+                                                         const Eigen::Vector3d &center = Eigen::Vector3d::Zero(),
+                                                         const double radius = -1.0) const;
+
         // 전역 포인트 클라우드를 내보냅니다.
         std::shared_ptr<open3d::geometry::PointCloud> export_global_pcd(bool filter = false, float vx_size = -1.0);
 
@@ -114,8 +119,8 @@ namespace fmfusion {  // fmfusion 네임스페이스 정의
                                      const std::vector<InstanceId> &new_instances);
 
         // 두 레이블 간 유사성을 확인합니다.
-        bool IsSemanticSimilar(const std::unordered_map<std::string, float> &measured_labels_a,
-                               const std::unordered_map<std::string, float> &measured_labels_b);
+        bool IsSemanticSimilar(const LabelSet &measured_labels_a,
+                               const LabelSet &measured_labels_b);
 
         // 두 바운딩 박스 간 2D IoU를 계산합니다.
         double Compute2DIoU(const open3d::geometry::OrientedBoundingBox &box_a,
@@ -124,6 +129,12 @@ namespace fmfusion {  // fmfusion 네임스페이스 정의
         // 두 포인트 클라우드 간 3D IoU를 계산합니다.
         double Compute3DIoU(const O3d_Cloud_Ptr &cloud_a, const O3d_Cloud_Ptr &cloud_b, double inflation = 1.0);
 
+        // 인스턴스의 예측 라벨로 세맨틱 사전을 갱신합니다.
+        void update_semantic_dict(const InstancePtr &instance);
+
+        // 인스턴스를 인스턴스 맵과 세맨틱 사전에서 제거합니다.
+        void erase_instance(const InstanceId &instance_id);
+
         // 모호한 인스턴스를 병합합니다.
         int merge_ambiguous_instances(const std::vector<std::pair<InstanceId, InstanceId>> &ambiguous_pairs);
 
@@ -135,7 +146,6 @@ namespace fmfusion {  // fmfusion 네임스페이스 정의
         MappingConfig mapping_config;
         InstanceConfig instance_config;
         std::unordered_map<InstanceId, InstancePtr> instance_map;
-        std::unordered_map<std::string, std::vector<InstanceId>> label_instance_map;
         SemanticDictServer semantic_dict_server;
         BayesianLabel *bayesian_label;
 
@@ -45,26 +45,104 @@ namespace fmfusion
     {
         int Q = words.size();  // 단어 수
         if(Q<1) return false;  // 단어 수가 1보다 적으면 실패
-        float indices[Q];  // 단어 인덱스 배열
 
-        // 각 단어에 대해 인덱스를 찾아 배열에 저장
+        // 사전에 없는 단어는 먼저 한 번에 인코딩하여 사전에 추가
+        std::vector<std::string> unknown_words;
         for(int i=0; i<Q; i++){
-            if(word2int.find(words[i]) == word2int.end()){  // 단어가 사전에 없으면
-                std::cerr<<"Error: word "<<words[i]<<" not found in the dictionary. Todo\n";  // 오류 메시지 출력
-                indices[i] = 0;  // 기본값 0 할당
-            }
-            else{
-                indices[i] = word2int[words[i]];  // 단어에 해당하는 인덱스 할당
-            } 
+            if(word2int.find(words[i]) == word2int.end()) find_row(words[i], unknown_words);
+        }
+        if(!unknown_words.empty()) append_unknown_words(unknown_words);
+
+        // 각 단어에 대해 인덱스를 찾아 재사용 버퍼에 저장
+        int64_t *indices = reserve_indices(Q);
+        for(int i=0; i<Q; i++){
+            auto it = word2int.find(words[i]);
+            indices[i] = it == word2int.end() ? 0 : it->second;  // 인코딩하지 못한 단어는 0 벡터
         }
- 
-        indices_tensor = torch::from_blob(indices, {Q}, torch::kFloat32).toType(torch::kInt64);  // 인덱스 텐서 생성
-        indices_tensor = indices_tensor.to(word_features.device());  // 텐서를 특징 텐서의 디바이스에 맞게 이동
-        features = torch::index_select(word_features, 0, indices_tensor);  // 인덱스로 단어 특징 선택
 
+        select_features(Q, features);
         return true;  // 성공적으로 쿼리 완료
     }
 
+    bool BertBow::query_semantic_features(const std::vector<LabelId> &label_ids,
+                                    torch::Tensor &features)
+    {
+        int Q = label_ids.size();  // 라벨 수
+        if(Q<1) return false;
+
+        // 처음 보는 라벨 ID만 문자열로 찾아 행을 캐시
+        std::vector<std::string> unknown_words;
+        for(const LabelId &id: label_ids){
+            if(id == LabelDict::UNSET) continue;  // 라벨이 없는 노드는 0 벡터
+            if(id >= label_rows.size()) label_rows.resize(id + 1, -1);
+            if(label_rows[id] < 0) label_rows[id] = find_row(LabelDict::name(id), unknown_words);
+        }
+        if(!unknown_words.empty()){
+            append_unknown_words(unknown_words);
+            for(const LabelId &id: label_ids){
+                if(id == LabelDict::UNSET || label_rows[id] >= 0) continue;
+                auto it = word2int.find(LabelDict::name(id));
+                if(it != word2int.end()) label_rows[id] = it->second;
+            }
+        }
+
+        int64_t *indices = reserve_indices(Q);
+        for(int i=0; i<Q; i++)
+            indices[i] = label_ids[i] == LabelDict::UNSET ? 0 : std::max<int64_t>(label_rows[label_ids[i]], 0);
+
+        select_features(Q, features);
+        return true;
+    }
+
+    int64_t BertBow::find_row(const std::string &word, std::vector<std::string> &unknown_words)
+    {
+        auto it = word2int.find(word);
+        if(it != word2int.end()) return it->second;
+        if(missing_words.count(word)==0
+            && std::find(unknown_words.begin(), unknown_words.end(), word) == unknown_words.end())
+            unknown_words.push_back(word);
+        return -1;
+    }
+
+    void BertBow::append_unknown_words(const std::vector<std::string> &unknown_words)
+    {
+        torch::Tensor new_features;
+        if(!unknown_word_encoder || !unknown_word_encoder(unknown_words, new_features)
+            || new_features.dim()!=2 || new_features.size(0)!=unknown_words.size()
+            || new_features.size(1)!=word_features.size(1)){
+            // 인코더가 없으면 0 벡터를 사용하고, 같은 단어에 대해 다시 경고하지 않음
+            for(const std::string &word: unknown_words){
+                std::cerr<<"Warning: word "<<word<<" not found in the dictionary. Use zero features\n";
+                missing_words.insert(word);
+            }
+            return;
+        }
+
+        int row = word_features.size(0);  // 새 단어의 첫 번째 행
+        new_features = new_features.to(word_features.device()).to(word_features.dtype());
+        word_features = torch::cat({word_features, new_features}, 0);  // 드물게 발생하므로 이어 붙임
+        for(const std::string &word: unknown_words) word2int[word] = row++;
+        N = word2int.size();
+        std::cout<<"Encode "<<unknown_words.size()<<" unknown words. "<<N<<" words in BertBow\n";
+    }
+
+    int64_t *BertBow::reserve_indices(int Q)
+    {
+        if(!index_buffer.defined() || index_buffer.size(0) < Q){
+            int64_t capacity = std::max<int64_t>(Q, index_buffer.defined() ? 2*index_buffer.size(0) : 64);
+            index_buffer = torch::empty({capacity},
+                                        torch::TensorOptions().dtype(torch::kInt64).pinned_memory(cuda_device));
+        }
+        return index_buffer.data_ptr<int64_t>();
+    }
+
+    void BertBow::select_features(int Q, torch::Tensor &features)
+    {
+        // 버퍼는 다음 쿼리에서 덮어쓰므로 동기 복사. pinned 메모리라 스테이징 복사 없음
+        indices_tensor = index_buffer.narrow(0, 0, Q).to(word_features.device());
+        features = torch::index_select(word_features, 0, indices_tensor);  // 인덱스로 단어 특징 선택
+    }
+
     // 단어-인덱스 맵을 파일에서 로드하는 함수
     bool BertBow::load_word2int(const std::string &word2int_file)
     {
@@ -11,16 +11,23 @@
 #define BERTBOW_H
 
 #include <fstream>  // 파일 입출력에 필요한 라이브러리
+#include <functional>  // 미등록 단어 인코더 콜백
 #include <iostream> // 표준 입출력에 필요한 라이브러리
-#include <map>      // 맵 자료구조에 필요한 라이브러리
+#include <unordered_map>  // 해시 맵 자료구조에 필요한 라이브러리
+#include <unordered_set>  // 해시 집합 자료구조에 필요한 라이브러리
 #include <torch/torch.h>  // PyTorch 텐서 관련 라이브러리
 
+#include <mapping/LabelDict.h>  // 전역 라벨 사전
+
 namespace fmfusion
 {
 
 // 파일에서 바이트를 읽어오는 함수
 std::vector<char> get_the_bytes(const std::string &filename);
 
+// 미등록 단어 인코더: 단어 U개를 받아 (U, D) 특징을 반환
+typedef std::function<bool(const std::vector<std::string> &, torch::Tensor &)> WordEncoder;
+
 // BertBow 클래스 정의
 class BertBow
 {
@@ -34,12 +41,22 @@ class BertBow
         /// 단어 N개를 읽고, NxD 특징을 반환하는 함수
         bool query_semantic_features(const std::vector<std::string> &words, 
                                     torch::Tensor &features);
+
+        /// \brief 전역 사전에 등록된 라벨 ID N개를 읽고, NxD 특징을 반환하는 함수.
+        ///        라벨 ID -> 특징 행 변환은 배열로 캐시되어 문자열 해시 없이 조회합니다.
+        ///        LabelDict::UNSET은 0 벡터를 반환합니다.
+        bool query_semantic_features(const std::vector<LabelId> &label_ids,
+                                    torch::Tensor &features);
+
+        /// \brief 사전에 없는 단어를 인코딩할 함수 설정. 인코딩된 단어는 특징 텐서 뒤에 추가되어
+        ///        다음 쿼리부터 일반 단어처럼 조회됩니다. 설정하지 않으면 0 벡터를 사용합니다.
+        void set_unknown_word_encoder(const WordEncoder &encoder) {unknown_word_encoder = encoder;};
                                     
         // 로드 성공 여부를 반환하는 함수
         bool is_loaded() const {return load_success;};
 
         // word2int 맵을 외부로 전달하는 함수
-        void get_word2int(std::map<std::string, int>& word2int_map)const{
+        void get_word2int(std::unordered_map<std::string, int>& word2int_map)const{
             word2int_map = word2int;
         }
 
@@ -53,14 +70,31 @@ class BertBow
         // 초기화 작업을 위한 워밍업 함수
         void warm_up();
 
+        /// \brief 단어의 특징 행을 찾는 함수. 사전에 없는 단어는 unknown_words에 모으고 -1을 반환
+        int64_t find_row(const std::string &word, std::vector<std::string> &unknown_words);
+
+        /// \brief 사전에 없는 단어들을 한 번에 인코딩하여 사전과 특징 텐서에 추가하는 함수
+        void append_unknown_words(const std::vector<std::string> &unknown_words);
+
+        // 재사용 인덱스 버퍼의 용량을 확보하고 데이터 포인터를 반환하는 함수
+        int64_t *reserve_indices(int Q);
+
+        // 인덱스 버퍼의 앞 Q개로 특징을 선택하는 함수
+        void select_features(int Q, torch::Tensor &features);
+
     private:
         bool load_success;  // 로드 성공 여부
         bool cuda_device;   // CUDA 장치 사용 여부
-        std::map<std::string, int> word2int;  // 단어와 인덱스를 매핑한 맵
+        std::unordered_map<std::string, int> word2int;  // 단어와 인덱스를 매핑한 해시 맵
         torch::Tensor word_features;  // 단어 특징을 저장할 텐서
         int N;  // 단어 수
 
         torch::Tensor indices_tensor;  // 인덱스 텐서
+        torch::Tensor index_buffer;  // 재사용 int64 인덱스 버퍼 (CUDA 사용 시 pinned 메모리)
+        std::vector<int64_t> label_rows;  // 라벨 ID -> 특징 행 (-1은 미확인)
+
+        WordEncoder unknown_word_encoder;  // 미등록 단어 인코더
+        std::unordered_set<std::string> missing_words;  // 인코딩하지 못한 단어 (경고는 한 번만)
 };
 
 } // namespace fmfusion
@@ -1,49 +1,19 @@
+#include <atomic>  // 데이터 사전 버전 카운터
+#include <random>  // 코너 샘플링을 위한 난수 생성기
 #include "Graph.h"  // Graph 클래스와 Node 클래스 선언이 포함된 헤더 파일 포함
 
 namespace fmfusion
 {
-    void Node::sample_corners(const int &max_corner_number, std::vector<Corner> &corner_vector, int padding_value)
+    // 간선 생성 시 사용하는 노드 분류
+    enum NodeSemanticClass : uint8_t
     {
-        // corners에서 샘플링한 결과를 corner_vector에 저장하는 함수
-        // 최대 코너 개수(max_corner_number)에 맞게 코너를 샘플링하거나, 부족하면 패딩 값을 추가
+        OBJECT_NODE = 0,
+        FLOOR_NODE = 1,
+        CEILING_NODE = 2
+    };
 
-        // 디버깅 메시지를 저장하기 위한 스트링 스트림 초기화
-        std::stringstream msg;
-        msg<<corners.size()<<" corners: ";  // 현재 코너 개수를 메시지에 추가
-        corner_vector.reserve(max_corner_number);  // corner_vector의 용량을 미리 예약
-
-        // 패딩에 사용될 Corner 객체 생성
-        Corner padding_corner = {(uint32_t)padding_value, (uint32_t)padding_value};
-
-        if (corners.size()<max_corner_number){
-            // 현재 코너 개수가 최대 코너 개수보다 적은 경우
-
-            corner_vector.insert(corner_vector.end(), corners.begin(), corners.end());  // 코너 벡터에 기존 코너 추가
-
-            // 부족한 부분을 패딩 값으로 채움
-            for (int i=corners.size(); i<max_corner_number; i++){
-                corner_vector.emplace_back(padding_corner);
-            }
-        }
-        else if (corners.size()==max_corner_number){
-            // 현재 코너 개수가 최대 코너 개수와 같은 경우
-
-            corner_vector.insert(corner_vector.end(), corners.begin(), corners.end());  // 그대로 복사
-        }
-        else{
-            // 현재 코너 개수가 최대 코너 개수보다 많은 경우
-
-            std::vector<int> indices(corners.size());  // 인덱스를 저장할 벡터 생성
-            std::iota(indices.begin(), indices.end(), 0);  // 0부터 시작하는 연속된 값으로 채움
-            std::random_shuffle(indices.begin(), indices.end());  // 인덱스를 무작위로 섞음
-            for (int i=0; i<max_corner_number; i++){
-                corner_vector.emplace_back(corners[indices[i]]);  // 무작위로 선택된 코너를 추가
-            }
-        }
-        assert(corner_vector.size()==max_corner_number);  // corner_vector 크기 확인 (디버깅용)
-        msg<<"\n";  // 메시지 끝에 줄바꿈 추가
-        // std::cout<<msg.str();  // 디버깅 메시지 출력 (현재 비활성화)
-    }
+    // 모든 그래프가 공유하는 데이터 사전 버전 카운터. 다른 그래프의 사전과도 버전이 겹치지 않음
+    static std::atomic<uint64_t> data_dict_version_counter{0};
 
     Graph::Graph(GraphConfig config_):config(config_),max_corner_number(0),max_neighbor_number(0),frame_id(-1),timestamp(-1.0)
     {
@@ -66,19 +36,17 @@ namespace fmfusion
             // 입력된 각 인스턴스를 처리하여 노드로 변환
 
             NodePtr node = std::make_shared<Node>(nodes.size(), inst->get_id());  // 새 노드 생성
-            std::string label = inst->get_predicted_class().first;  // 예측된 클래스 레이블 가져오기
+            const std::string &label = inst->get_predicted_class().first;  // 예측된 클래스 레이블 가져오기 (복사 없음)
             if (config.ignore_labels.find(label)!=std::string::npos) continue;  // 무시할 레이블인 경우 건너뜀
 
-            node->semantic = label;  // 노드의 레이블 설정
+            node->set_semantic(label);  // 노드의 레이블과 라벨 ID 설정
             node->centroid = inst->centroid;  // 중심 좌표 설정
             node->bbox_shape = inst->min_box->extent_;  // 바운딩 박스 크기 설정
             node->cloud = std::make_shared<open3d::geometry::PointCloud>(*inst->point_cloud);  // 포인트 클라우드 깊은 복사
             if (config.voxel_size>0.0)
                 node->cloud = node->cloud->VoxelDownSample(config.voxel_size);  // 복셀 다운샘플링 수행
 
-            nodes.push_back(node);  // 생성된 노드를 노드 리스트에 추가
-            node_instance_idxs.push_back(inst->get_id());  // 인스턴스 ID를 노드 ID 리스트에 추가
-            instance2node_idx[inst->get_id()] = node->id;  // 인스턴스 ID와 노드 ID 매핑
+            append_node(node);  // 생성된 노드를 노드 리스트에 추가
         }
         timer_.Stop();  // 타이머 종료
         std::cout<<"Constructed "<<nodes.size()<<" nodes in "
@@ -98,10 +66,9 @@ namespace fmfusion
             for (int i=0; i<instances.size(); i++){
                 NodePtr node = std::make_shared<Node>(node_indices[i], instances[i]);  // 새로운 노드 생성
                 node->centroid = centroids[i];  // 노드 중심 좌표 설정
+                node->bbox_shape = Eigen::Vector3d::Zero();  // 거친 노드는 바운딩 박스 정보 없음
                 node->cloud = std::make_shared<open3d::geometry::PointCloud>();  // 빈 포인트 클라우드 초기화
-                nodes.push_back(node);  // 생성된 노드를 노드 리스트에 추가
-                node_instance_idxs.push_back(instances[i]);  // 인스턴스 ID를 노드 ID 리스트에 추가
-                instance2node_idx[instances[i]] = i;  // 인스턴스 ID와 노드 ID 매핑
+                append_node(node);  // 생성된 노드를 노드 리스트에 추가
                 msg<<instances[i]<<",";  // 디버깅 메시지에 인스턴스 ID 추가
             }
             timestamp = latest_timestamp;  // 그래프 타임스탬프 갱신
@@ -137,6 +104,7 @@ namespace fmfusion
             nodes[i]->cloud = std::make_shared<open3d::geometry::PointCloud>(nodes_points[i]);  // 포인트 클라우드 갱신
             count += nodes_points[i].size();  // 갱신된 포인트 수 누적
         }
+        if (count > 0) data_dict_valid = false;  // 포인트가 바뀌었으므로 데이터 사전을 다시 추출해야 함
 
         return count;  // 총 갱신된 포인트 수 반환
     }
@@ -144,95 +112,107 @@ namespace fmfusion
     void Graph::construct_edges()
     {
         // 그래프에서 노드 간의 간선을 생성하는 함수
-        // 노드들 사이의 거리 및 특정 조건에 따라 간선을 추가
+        // 노드별 분류와 탐색 반경을 한 번만 계산하고, KD-tree로 최대 탐색 반경 안의 후보 노드만 검사
 
         std::string floor_names = "floor. carpet.";  // 바닥과 관련된 레이블 정의
         std::string ceiling_names = "ceiling.";  // 천장과 관련된 레이블 정의
-        std::set<uint32_t> floors, ceilings;  // 바닥 및 천장 노드의 인덱스를 저장
         const int N = nodes.size();  // 그래프의 노드 개수
-        std::stringstream msg;  // 디버깅 메시지를 저장하기 위한 스트링 스트림 초기화
-        std::stringstream edge_msgs;  // 간선 정보 메시지 저장
         float MIN_SEARCH_RADIUS = 1.0;  // 최소 탐색 반경
         float MAX_SEARCH_RADIUS = 6.0;  // 최대 탐색 반경
         o3d_utility::Timer timer_;  // 실행 시간 측정을 위한 타이머 객체 생성
         timer_.Start();  // 타이머 시작
 
-        // 노드 간 객체-객체 연결
+        // 노드별 분류(바닥/천장/객체)와 탐색 반경 사전 계산
+        std::vector<uint8_t> node_class(N, OBJECT_NODE);
+        std::vector<float> node_radius(N, 0.0);
+        std::vector<int> floors, objects;  // 바닥 노드와 객체 노드의 인덱스 (오름차순)
+        float max_radius = 0.0;  // 객체 노드 반경의 최댓값
         for (int i=0; i<N; i++){
-            const NodePtr src = nodes[i];  // 현재 노드 가져오기
-            float radius_src;
-
-            // 노드가 바닥 또는 천장 레이블에 속하는 경우 인덱스를 저장하고 건너뜀
-            if (floor_names.find(src->semantic) != std::string::npos){
-                floors.emplace(i);
+            const NodePtr &node = nodes[i];
+            if (floor_names.find(node->get_semantic()) != std::string::npos){
+                node_class[i] = FLOOR_NODE;
+                floors.emplace_back(i);
                 continue;
             }
-            if (ceiling_names.find(src->semantic) != std::string::npos){
-                ceilings.emplace(i);
+            if (ceiling_names.find(node->get_semantic()) != std::string::npos){
+                node_class[i] = CEILING_NODE;
                 continue;
             }
 
             // 벽인 경우 최소 탐색 반경 사용, 아니면 바운딩 박스 크기를 기준으로 반경 계산
-            if (src->semantic.find("wall") != std::string::npos)
-                radius_src = MIN_SEARCH_RADIUS;
+            if (node->get_semantic().find("wall") != std::string::npos)
+                node_radius[i] = MIN_SEARCH_RADIUS;
             else
-                radius_src = src->bbox_shape.norm() / 2.0;
-
-            msg << src->semantic << "(" << radius_src << "): ";
-
-            for (int j = i + 1; j < N; j++) {
-                const NodePtr ref = nodes[j];  // 비교할 다른 노드 가져오기
-
-                // 동일 노드이거나 바닥/천장 노드인 경우 건너뜀
-                if (src->id == ref->id || 
-                    floor_names.find(ref->semantic) != std::string::npos || 
-                    ceiling_names.find(ref->semantic) != std::string::npos)
-                    continue;
-
-                float radius_ref;
-
-                // 비교 대상이 벽인 경우 최소 탐색 반경 사용, 아니면 바운딩 박스 크기를 기준으로 반경 계산
-                if (ref->semantic.find("wall") != std::string::npos)
-                    radius_ref = MIN_SEARCH_RADIUS;
-                else
-                    radius_ref = ref->bbox_shape.norm() / 2.0;
-
-                // 두 노드 간의 탐색 반경 계산
-                float search_radius = config.edge_radius_ratio * std::max(radius_src, radius_ref);
-                search_radius = std::max(std::min(search_radius, MAX_SEARCH_RADIUS), MIN_SEARCH_RADIUS);
-
-                // 두 노드 간의 거리 계산
-                float dist = (src->centroid - ref->centroid).norm();
-
-                msg << "(" << radius_ref << ")(" << search_radius << "),";
+                node_radius[i] = node->bbox_shape.norm() / 2.0;
+            max_radius = std::max(max_radius, node_radius[i]);
+            objects.emplace_back(i);
+        }
 
-                // 두 노드 간의 거리가 탐색 반경 내에 있으면 간선 추가
-                if (dist < search_radius) {
-                    EdgePtr edge = std::make_shared<Edge>(i, j);  // 간선 생성
-                    edges.push_back(edge);  // 간선 리스트에 추가
-                    edge_msgs << "(" << src->instance_id << "," << ref->instance_id << "),";
+        // 노드 간 객체-객체 연결. 쓰레드별 간선 벡터에 저장한 뒤 합침
+        std::vector<std::pair<int, int>> object_edges;
+        int M = objects.size();
+        if (M > 1){
+            open3d::geometry::PointCloud object_centroids;  // 객체 노드 중심으로 KD-tree 구성
+            object_centroids.points_.reserve(M);
+            for (int i : objects) object_centroids.points_.emplace_back(nodes[i]->centroid);
+            open3d::geometry::KDTreeFlann object_kdtree(object_centroids);
+
+#pragma omp parallel default(none) shared(M, objects, node_radius, max_radius, object_kdtree, object_edges, MIN_SEARCH_RADIUS, MAX_SEARCH_RADIUS)
+            {
+                std::vector<std::pair<int, int>> thread_edges;
+                std::vector<int> candidates;
+                std::vector<double> candidate_dists;  // 제곱 거리
+
+#pragma omp for schedule(dynamic, 8) nowait
+                for (int a = 0; a < M; a++){
+                    const int i = objects[a];
+
+                    // 어떤 상대 노드에 대해서도 탐색 반경은 이 값을 넘지 않음
+                    float query_radius = config.edge_radius_ratio * std::max(node_radius[i], max_radius);
+                    query_radius = std::max(std::min(query_radius, MAX_SEARCH_RADIUS), MIN_SEARCH_RADIUS);
+                    object_kdtree.SearchRadius(nodes[i]->centroid, (double)query_radius, candidates, candidate_dists);
+
+                    for (size_t k = 0; k < candidates.size(); k++){
+                        const int b = candidates[k];
+                        if (b <= a) continue;  // 각 쌍은 i < j 방향으로 한 번만 검사
+                        const int j = objects[b];
+
+                        // 두 노드 간의 탐색 반경 계산
+                        float search_radius = config.edge_radius_ratio * std::max(node_radius[i], node_radius[j]);
+                        search_radius = std::max(std::min(search_radius, MAX_SEARCH_RADIUS), MIN_SEARCH_RADIUS);
+
+                        // 두 노드 간의 거리가 탐색 반경 내에 있으면 간선 추가
+                        float dist = std::sqrt(candidate_dists[k]);
+                        if (dist < search_radius) thread_edges.emplace_back(i, j);
+                    }
                 }
+
+#pragma omp critical
+                object_edges.insert(object_edges.end(), thread_edges.begin(), thread_edges.end());
             }
-            msg << "\n";
+        }
+
+        // 쓰레드 실행 순서와 무관하게 (i, j) 순서로 정렬하여 결과를 결정적으로 유지
+        std::sort(object_edges.begin(), object_edges.end());
+        edges.reserve(edges.size() + object_edges.size() + (config.involve_floor_edge ? N : 0));
+        for (const auto &edge : object_edges){
+            edges.emplace_back(edge.first, edge.second);  // 간선 리스트에 추가
         }
 
         // 바닥과의 연결을 포함하도록 설정된 경우
         if (config.involve_floor_edge && !floors.empty()) {
-            for (int i = 0; i < N; i++) {  // 각 노드를 가장 가까운 바닥 노드와 연결
-                if (floors.find(i) != floors.end()) continue;  // 이미 바닥 노드인 경우 건너뜀
-
-                std::pair<int, float> closet_floor = std::make_pair(-1, 1000000.0);  // 가장 가까운 바닥 노드 초기화
-                const NodePtr src = nodes[i];
+            open3d::geometry::PointCloud floor_centroids;  // 바닥 노드 중심으로 KD-tree 구성
+            floor_centroids.points_.reserve(floors.size());
+            for (int i : floors) floor_centroids.points_.emplace_back(nodes[i]->centroid);
+            open3d::geometry::KDTreeFlann floor_kdtree(floor_centroids);
 
-                for (auto floor_index : floors) {
-                    float dist = (src->centroid - nodes[floor_index]->centroid).norm();  // 거리 계산
-                    if (dist < closet_floor.second)
-                        closet_floor = std::make_pair(floor_index, dist);  // 더 가까운 노드로 갱신
-                }
+            std::vector<int> closet_floor(1);
+            std::vector<double> closet_dist(1);
+            for (int i = 0; i < N; i++) {  // 각 노드를 가장 가까운 바닥 노드와 연결
+                if (node_class[i] == FLOOR_NODE) continue;  // 이미 바닥 노드인 경우 건너뜀
 
-                if (closet_floor.first >= 0) {  // 유효한 간선인 경우 추가
-                    EdgePtr edge = std::make_shared<Edge>(i, closet_floor.first);
-                    edges.push_back(edge);
+                if (floor_kdtree.SearchKNN(nodes[i]->centroid, 1, closet_floor, closet_dist) > 0) {  // 유효한 간선인 경우 추가
+                    edges.emplace_back(i, floors[closet_floor[0]]);
                 }
             }
         }
@@ -243,38 +223,130 @@ namespace fmfusion
         update_neighbors();
     }
 
+    void Graph::append_node(const NodePtr &node)
+    {
+        // 노드를 추가하고, 인코더 입력으로 쓰이는 연속 배열도 함께 채움
+        instance2node_idx[node->instance_id] = nodes.size();  // 인스턴스 ID와 노드 인덱스 매핑
+        node_instance_idxs.push_back(node->instance_id);  // 인스턴스 ID를 노드 ID 리스트에 추가
+        for (int k = 0; k < 3; k++) {
+            node_centroids.push_back(node->centroid[k]);
+            node_boxes.push_back(node->bbox_shape[k]);
+        }
+        nodes.push_back(node);
+        data_dict_valid = false;
+    }
+
     void Graph::update_neighbors()
     {
-        // 간선 정보를 기반으로 각 노드의 이웃 노드 목록을 업데이트
-        for (auto edge : edges) {
-            nodes[edge->src_id]->neighbors.push_back(edge->ref_id);  // 간선의 시작 노드에 이웃 추가
-            nodes[edge->ref_id]->neighbors.push_back(edge->src_id);  // 간선의 끝 노드에 이웃 추가
+        // 간선 정보를 기반으로 CSR 이웃 배열을 구성 (간선 순서대로 이웃이 기록됨)
+        const int N = nodes.size();
+        neighbor_offsets.assign(N + 1, 0);
+        for (const Edge &edge : edges) {
+            neighbor_offsets[edge.src_id + 1]++;
+            neighbor_offsets[edge.ref_id + 1]++;
+        }
+        for (int i = 0; i < N; i++) neighbor_offsets[i + 1] += neighbor_offsets[i];
+
+        neighbor_indices.resize(neighbor_offsets[N]);
+        std::vector<uint32_t> fill_position(neighbor_offsets.begin(), neighbor_offsets.end() - 1);
+        for (const Edge &edge : edges) {
+            neighbor_indices[fill_position[edge.src_id]++] = edge.ref_id;  // 간선의 시작 노드에 이웃 추가
+            neighbor_indices[fill_position[edge.ref_id]++] = edge.src_id;  // 간선의 끝 노드에 이웃 추가
         }
     }
 
-    void Graph::construct_triplets()
+    void Graph::construct_triplets(const int &triplet_number)
     {
-        // 각 노드의 이웃 간 조합으로 코너(Triplet)를 생성
-        for (NodePtr &node : nodes) {
-            std::stringstream neighbor_msg, corner_msg;  // 디버깅 메시지 초기화
-            if (node->neighbors.size() < 2) continue;  // 이웃이 2개 미만이면 건너뜀
-
-            for (int i = 0; i < node->neighbors.size(); i++) {
-                neighbor_msg << node->neighbors[i] << ",";
-                for (int j = i + 1; j < node->neighbors.size(); j++) {
-                    Corner corner = {node->neighbors[i], node->neighbors[j]};  // 코너 생성
-                    node->corners.push_back(corner);  // 노드에 코너 추가
-                    corner_msg << "(" << corner[0] << "," << corner[1] << "),";
+        // 각 노드의 이웃 쌍(코너) 중 최대 triplet_number개를 연속 배열에 저장
+        // 이웃 쌍이 더 많으면 모든 쌍을 만들지 않고, 쌍 인덱스를 직접 비복원 추출 (Floyd 알고리즘)
+        // 노드별 시드는 (triplet_seed, 노드 인덱스)로 고정되므로 실행마다 같은 결과를 얻음
+        const int N = nodes.size();
+        if (neighbor_offsets.size() != N + 1) update_neighbors();
+
+        corner_offsets.assign(N + 1, 0);
+        for (int i = 0; i < N; i++) {
+            const int deg = get_neighbor_number(i);
+            const int pairs = deg < 2 ? 0 : deg * (deg - 1) / 2;
+            corner_offsets[i + 1] = corner_offsets[i] + std::min(pairs, triplet_number);
+        }
+
+        corner_array.resize(corner_offsets[N]);
+        std::vector<int> sampled_pairs;
+        sampled_pairs.reserve(triplet_number);
+        for (int n = 0; n < N; n++) {
+            const int deg = get_neighbor_number(n);
+            if (deg < 2) continue;  // 이웃이 2개 미만이면 건너뜀
+
+            const uint32_t *neighbors = neighbors_begin(n);
+            const int pairs = deg * (deg - 1) / 2;
+            Corner *corner = corner_array.data() + corner_offsets[n];
+
+            if (pairs <= triplet_number) {  // 모든 쌍 사용
+                for (int i = 0; i < deg; i++) {
+                    for (int j = i + 1; j < deg; j++) {
+                        *corner++ = {neighbors[i], neighbors[j]};  // 코너 생성
+                    }
+                }
+            }
+            else {
+                std::seed_seq seed{(uint32_t)config.triplet_seed, (uint32_t)n};
+                std::mt19937 rng(seed);
+                sampled_pairs.clear();
+                for (int k = pairs - triplet_number; k < pairs; k++) {  // Floyd 비복원 추출
+                    int t = std::uniform_int_distribution<int>(0, k)(rng);
+                    if (std::find(sampled_pairs.begin(), sampled_pairs.end(), t) != sampled_pairs.end()) t = k;
+                    sampled_pairs.push_back(t);
+                }
+                std::sort(sampled_pairs.begin(), sampled_pairs.end());  // 쌍 나열 순서대로 정렬
+
+                // 상삼각 쌍 인덱스 -> (i, j) 변환. 정렬되어 있으므로 한 번의 순회로 처리
+                int i = 0, row_start = 0;
+                for (int t : sampled_pairs) {
+                    while (t >= row_start + (deg - 1 - i)) {
+                        row_start += deg - 1 - i;
+                        i++;
+                    }
+                    const int j = i + 1 + (t - row_start);
+                    *corner++ = {neighbors[i], neighbors[j]};
                 }
             }
 
             // 최대 이웃 수와 최대 코너 수 업데이트
-            if (node->neighbors.size() > max_neighbor_number) max_neighbor_number = node->neighbors.size();
-            if (node->corners.size() > max_corner_number) max_corner_number = node->corners.size();
+            if (deg > max_neighbor_number) max_neighbor_number = deg;
+            if (get_corner_number(n) > max_corner_number) max_corner_number = get_corner_number(n);
         }
         assert(max_corner_number > 0);  // 코너가 존재해야 함
     }
 
+    int Graph::sample_triplets(const int &triplet_number,
+                               std::vector<int32_t> &anchors,
+                               std::vector<int32_t> &corners,
+                               std::vector<int32_t> &corners_mask) const
+    {
+        // 코너가 있는 노드마다 triplet_number개의 코너를 연속 배열에 기록
+        // 코너는 construct_triplets에서 이미 추출되었으므로, 부족한 부분만 N으로 채움
+        const int N = nodes.size();
+        anchors.clear();
+        corners.clear();
+        corners_mask.clear();
+        if (corner_offsets.size() != N + 1) return 0;
+
+        for (int n = 0; n < N; n++) {
+            const int C = get_corner_number(n);
+            if (C < 1) continue;
+            anchors.push_back(n);
+
+            const Corner *node_corners = corner_array.data() + corner_offsets[n];
+            for (int k = 0; k < triplet_number; k++) {
+                const bool valid = k < C;
+                corners.push_back(valid ? node_corners[k][0] : N);
+                corners.push_back(valid ? node_corners[k][1] : N);
+                corners_mask.push_back(valid ? 1 : 0);
+            }
+        }
+        return anchors.size();
+    }
+
     void Graph::extract_global_cloud(std::vector<Eigen::Vector3d> &xyz, std::vector<uint32_t> &labels)
     {
         // 그래프의 모든 노드에서 포인트 클라우드와 라벨을 추출
@@ -305,24 +377,53 @@ namespace fmfusion
         edges.clear();
         node_instance_idxs.clear();
         instance2node_idx.clear();
+        node_centroids.clear();
+        node_boxes.clear();
+        neighbor_offsets.clear();
+        neighbor_indices.clear();
+        corner_offsets.clear();
+        corner_array.clear();
         max_corner_number = 0;
         max_neighbor_number = 0;
+        data_dict.clear();
+        data_dict_valid = false;
     }
 
-    DataDict Graph::extract_data_dict(bool coarse)
+    const DataDict &Graph::extract_data_dict(bool coarse)
     {
-        // 그래프 데이터를 DataDict 형식으로 추출
-        DataDict data_dict;
-        for (auto node : nodes) {
+        // 그래프 데이터를 DataDict 형식으로 추출. 노드가 바뀌지 않았다면 캐시를 그대로 반환
+        if (data_dict_valid && data_dict.coarse == coarse) return data_dict;
+
+        data_dict.clear();
+        data_dict.coarse = coarse;
+        size_t X = 0;
+        for (const auto &node : nodes) {
             data_dict.centroids.push_back(node->centroid);  // 중심 좌표 추가
             data_dict.nodes.push_back(node->id);  // 노드 ID 추가
             data_dict.instances.push_back(node->instance_id);  // 인스턴스 ID 추가
-            if (!coarse && node->cloud.use_count() > 0) {
-                data_dict.xyz.insert(data_dict.xyz.end(), node->cloud->points_.begin(), node->cloud->points_.end());  // 포인트 추가
-                data_dict.labels.insert(data_dict.labels.end(), node->cloud->points_.size(), node->id);  // 라벨 추가
+            if (!coarse && node->cloud.use_count() > 0) X += node->cloud->points_.size();
+        }
+
+        // 전체 포인트 수만큼 한 번에 할당한 뒤 float32로 변환하며 채움
+        data_dict.xyz.resize(3 * X);
+        data_dict.labels.resize(X);
+        if (!coarse) {
+            float *xyz_ptr = data_dict.xyz.data();
+            uint32_t *label_ptr = data_dict.labels.data();
+            for (const auto &node : nodes) {
+                if (node->cloud.use_count() == 0) continue;
+                for (const Eigen::Vector3d &pt : node->cloud->points_) {
+                    xyz_ptr[0] = pt[0];
+                    xyz_ptr[1] = pt[1];
+                    xyz_ptr[2] = pt[2];
+                    xyz_ptr += 3;
+                }
+                label_ptr = std::fill_n(label_ptr, node->cloud->points_.size(), node->id);  // 라벨 추가
             }
         }
-        data_dict.length_vec = std::vector<int>(1, data_dict.xyz.size());  // 길이 벡터 설정
+        data_dict.length_vec = std::vector<int>(1, X);  // 길이 벡터 설정
+        data_dict.version = ++data_dict_version_counter;  // 포인트나 라벨이 바뀌면 새 버전이 됨
+        data_dict_valid = true;
         return data_dict;
     }
 
@@ -331,7 +432,7 @@ namespace fmfusion
         // 바닥 레이블에 해당하는 노드의 포인트 클라우드를 지정된 색상으로 칠함
         std::string floor_names = "floor. carpet.";
         for (auto node : nodes) {
-            if (floor_names.find(node->semantic) != std::string::npos) {
+            if (floor_names.find(node->get_semantic()) != std::string::npos) {
                 node->cloud->PaintUniformColor(color);  // 포인트 클라우드에 색상 적용
             }
         }
@@ -351,8 +452,9 @@ namespace fmfusion
     {
         // 그래프의 모든 간선을 반환
         std::vector<std::pair<int, int>> edge_pairs;
-        for (auto edge : edges) {
-            edge_pairs.push_back(std::make_pair(edge->src_id, edge->ref_id));
+        edge_pairs.reserve(edges.size());
+        for (const Edge &edge : edges) {
+            edge_pairs.push_back(std::make_pair(edge.src_id, edge.ref_id));
         }
         return edge_pairs;
     }
@@ -3,6 +3,7 @@
 
 #include <Common.h>  // 공통 라이브러리 포함
 #include <mapping/Instance.h>  // 인스턴스 관련 정의 포함
+#include <mapping/LabelDict.h>  // 전역 라벨 사전 포함
 
 namespace fmfusion
 {
@@ -15,25 +16,32 @@ class Node
     public:
         // 생성자: 노드 ID와 인스턴스 ID로 초기화
         Node(uint32_t node_id_, InstanceId instance_id_) :
-            id(node_id_), instance_id(instance_id_) {};
-
-        /// @brief 코너를 샘플링하는 함수
-        /// @param max_corner_number 최대 코너 개수
-        /// @param corner_vector 결과 코너를 저장할 벡터
-        /// @param padding_value 부족한 코너를 채우기 위한 패딩 값
-        void sample_corners(const int &max_corner_number, std::vector<Corner> &corner_vector, int padding_value = 0);
+            id(node_id_), instance_id(instance_id_), semantic_id(LabelDict::UNSET) {};
 
         ~Node() {};
 
+        // 의미적 레이블과 전역 라벨 ID를 함께 설정
+        void set_semantic(const std::string &label) {
+            semantic = label;
+            semantic_id = LabelDict::intern(label);
+        }
+
+        const std::string &get_semantic() const { return semantic; }  // 의미적 레이블 반환
+
+        LabelId get_semantic_id() const { return semantic_id; }  // 전역 라벨 ID 반환 (미지정이면 LabelDict::UNSET)
+
     public:
+        // 이웃과 코너는 Graph의 CSR 배열에 저장됩니다.
         uint32_t id;  // 노드 ID
         InstanceId instance_id;  // 원래 인스턴스 ID와 매칭
-        std::string semantic;  // 노드의 의미적 레이블
-        std::vector<uint32_t> neighbors;  // 이웃 노드 목록
-        std::vector<Corner> corners;  // 코너 목록 (이웃 간 조합)
         O3d_Cloud_Ptr cloud;  // 노드의 포인트 클라우드
         Eigen::Vector3d centroid;  // 노드 중심 좌표
         Eigen::Vector3d bbox_shape;  // 바운딩 박스 크기 (x, y, z)
+
+    private:
+        // 두 값은 set_semantic으로만 함께 바뀜
+        std::string semantic;  // 노드의 의미적 레이블
+        LabelId semantic_id;  // semantic의 전역 라벨 ID
 };
 typedef std::shared_ptr<Node> NodePtr;  // Node 클래스의 스마트 포인터 정의
 
@@ -55,13 +63,18 @@ public:
 typedef std::shared_ptr<Edge> EdgePtr;  // Edge 클래스의 스마트 포인터 정의
 
 // 그래프 데이터를 저장하는 구조체
+// 포인트와 라벨은 연속 배열로 저장되어 torch::from_blob으로 복사 없이 텐서로 감쌀 수 있음
 struct DataDict {
-    std::vector<Eigen::Vector3d> xyz;  // 포인트 클라우드
+    std::vector<float> xyz;  // (X*3,) 행 우선 float32 포인트 클라우드
     std::vector<int> length_vec;  // 각 클라우드의 길이
-    std::vector<uint32_t> labels;  // 노드 ID 레이블
+    std::vector<uint32_t> labels;  // (X,) 노드 ID 레이블
     std::vector<Eigen::Vector3d> centroids;  // 중심 좌표
     std::vector<uint32_t> nodes;  // 노드 ID
     std::vector<uint32_t> instances;  // 인스턴스 ID
+    bool coarse = false;  // 포인트 없이 노드 정보만 추출했는지 여부
+    uint64_t version = 0;  // 추출할 때마다 증가하는 전역 버전. 0은 출처를 알 수 없는 데이터 (캐시하지 않음)
+
+    int point_number() const { return labels.size(); }  // 포인트 수 반환
 
     // 인스턴스 ID를 출력하는 함수
     std::string print_instances() {
@@ -80,6 +93,7 @@ struct DataDict {
         centroids.clear();
         nodes.clear();
         instances.clear();
+        version = 0;
     }
 };
 
@@ -101,10 +115,34 @@ class Graph
                                      const std::vector<uint32_t> &labels);  // 밀집 포인트 클라우드 업데이트
 
         void construct_edges();  // 간선 생성
-        void construct_triplets();  // 코너 생성
-
-        const std::vector<NodePtr> get_const_nodes() const { return nodes; }  // 노드 반환
-        const std::vector<EdgePtr> get_const_edges() const { return edges; }  // 간선 반환
+        /// \brief 노드별로 최대 triplet_number개의 코너를 생성 (SgNetConfig::triplet_number와 같은 값 사용)
+        void construct_triplets(const int &triplet_number = 20);
+
+        const std::vector<NodePtr> &get_const_nodes() const { return nodes; }  // 노드 반환
+        const std::vector<Edge> &get_const_edges() const { return edges; }  // 간선 반환
+        int get_node_number() const { return nodes.size(); }  // 노드 수 반환
+
+        /// \brief 노드 i의 이웃 노드 (CSR 구간)
+        const uint32_t *neighbors_begin(int i) const { return neighbor_indices.data() + neighbor_offsets[i]; }
+        const uint32_t *neighbors_end(int i) const { return neighbor_indices.data() + neighbor_offsets[i + 1]; }
+        int get_neighbor_number(int i) const { return neighbor_offsets[i + 1] - neighbor_offsets[i]; }
+
+        /// \brief 노드 i의 코너 수 (construct_triplets 이후 유효)
+        int get_corner_number(int i) const { return corner_offsets[i + 1] - corner_offsets[i]; }
+
+        /// \brief (N,3) 행 우선 연속 배열. 노드 중심 좌표와 바운딩 박스 크기.
+        const float *get_centroid_data() const { return node_centroids.data(); }
+        const float *get_box_data() const { return node_boxes.data(); }
+
+        /// \brief 코너가 있는 노드마다 triplet_number개의 코너를 패딩하여 연속 배열에 씁니다.
+        /// \param anchors         (N_valid,) 코너가 있는 노드 인덱스
+        /// \param corners         (N_valid, triplet_number, 2) 코너 노드 인덱스. 부족한 코너는 N으로 채움
+        /// \param corners_mask    (N_valid, triplet_number) 유효한 코너이면 1
+        /// \return N_valid
+        int sample_triplets(const int &triplet_number,
+                            std::vector<int32_t> &anchors,
+                            std::vector<int32_t> &corners,
+                            std::vector<int32_t> &corners_mask) const;
         const std::vector<std::pair<int, int>> get_edges() const;  // 노드 간 간선 반환
         const std::vector<Eigen::Vector3d> get_centroids() const;  // 중심 좌표 반환
 
@@ -112,7 +150,8 @@ class Graph
 
         void extract_global_cloud(std::vector<Eigen::Vector3d> &xyz, std::vector<uint32_t> &labels);  // 전체 클라우드 추출
 
-        DataDict extract_data_dict(bool coarse = false);  // 데이터 사전 추출
+        /// \brief 데이터 사전 추출. 그래프가 바뀌기 전까지 한 번 만든 결과를 재사용합니다.
+        const DataDict &extract_data_dict(bool coarse = false);
         O3d_Cloud_Ptr extract_global_cloud(float vx_size = -1.0) const;  // 다운샘플링된 클라우드 추출
 
         DataDict extract_coarse_data_dict();  // 간단한 데이터 사전 추출
@@ -129,7 +168,9 @@ class Graph
         ~Graph() {};
 
     private:
-        void update_neighbors();  // 이웃 노드 갱신
+        void update_neighbors();  // 이웃 노드 갱신 (CSR 구성)
+
+        void append_node(const NodePtr &node);  // 노드와 연속 배열에 노드 추가
 
     public:
         int max_neighbor_number;  // 최대 이웃 수
@@ -137,10 +178,20 @@ class Graph
 
     private:
         GraphConfig config;  // 그래프 설정
-        std::map<InstanceId, int> instance2node_idx;  // 인스턴스 ID와 노드 인덱스 매핑
+        std::unordered_map<InstanceId, int> instance2node_idx;  // 인스턴스 ID와 노드 인덱스 매핑
         std::vector<InstanceId> node_instance_idxs;  // 노드의 인스턴스 ID 목록
         std::vector<NodePtr> nodes;  // 노드 목록
-        std::vector<EdgePtr> edges;  // 간선 목록
+        std::vector<Edge> edges;  // 간선 목록 (연속 배열)
+
+        std::vector<float> node_centroids;  // (N,3) 노드 중심 좌표
+        std::vector<float> node_boxes;  // (N,3) 노드 바운딩 박스 크기
+        std::vector<uint32_t> neighbor_offsets;  // (N+1,) CSR 이웃 오프셋
+        std::vector<uint32_t> neighbor_indices;  // (2E,) CSR 이웃 인덱스
+        std::vector<uint32_t> corner_offsets;  // (N+1,) 노드별 코너 오프셋
+        std::vector<Corner> corner_array;  // 모든 노드의 코너 (연속 배열)
+
+        DataDict data_dict;  // 추출된 데이터 사전 캐시
+        bool data_dict_valid = false;  // 캐시가 현재 노드와 일치하는지 여부
 
         int frame_id;  // 최근 프레임 ID
         float timestamp;  // 최근 타임스탬프
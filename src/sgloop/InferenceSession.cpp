@@ -0,0 +1,73 @@
+#include <iomanip>
+#include <torch/cuda.h>
+#include <open3d/Open3D.h>
+
+#include "InferenceSession.h"
+
+namespace fmfusion
+{
+
+bool InferenceModule::load(const std::string &path, const std::string &device_string_, bool optimize)
+{
+    device_string = device_string_;
+    loaded = false;
+    try {
+        module = torch::jit::load(path);  // 모델 로드
+        module.to(device_string);  // 추론 장치로 이동
+        module.eval();  // 평가 모드로 설정
+    }
+    catch (const std::exception &e) {
+        std::cerr << "Error loading " << name << " from " << path << "\n" << e.what() << '\n';
+        return false;
+    }
+
+    if (optimize) {
+        // freeze는 파라미터를 상수로 접고, optimize_for_inference는 연산자 융합 등을 적용
+        try {
+            module = torch::jit::freeze(module);
+            module = torch::jit::optimize_for_inference(module);
+        }
+        catch (const std::exception &e) {
+            open3d::utility::LogWarning("Skip freezing {}: {}", name, e.what());
+        }
+    }
+
+    loaded = true;
+    std::cout << "Load " << name << " from " << path << " on " << device_string << std::endl;
+    return true;
+}
+
+torch::jit::IValue InferenceModule::forward(std::vector<torch::jit::IValue> inputs)
+{
+    c10::InferenceMode guard;  // autograd 기록 없이 실행
+    open3d::utility::Timer timer;
+    timer.Start();
+    torch::jit::IValue output = module.forward(std::move(inputs));
+    if (synchronize && device_string != "cpu") torch::cuda::synchronize();
+    timer.Stop();
+
+    double duration = timer.GetDurationInMillisecond();
+    calls++;
+    total_ms += duration;
+    max_ms = std::max(max_ms, duration);
+    return output;
+}
+
+std::string InferenceModule::print_latency() const
+{
+    std::stringstream msg;
+    msg << name << ": " << calls << " calls";
+    if (calls > 0)
+        msg << ", mean " << std::fixed << std::setprecision(1) << total_ms / calls
+            << " ms, max " << max_ms << " ms";
+    return msg.str();
+}
+
+void InferenceModule::reset_latency()
+{
+    calls = 0;
+    total_ms = 0.0;
+    max_ms = 0.0;
+}
+
+}
@@ -0,0 +1,59 @@
+/// \file 이 파일은 TorchScript 모듈의 추론 세션을 정의합니다.
+///     모든 모델 호출은 InferenceMode에서 실행되고, 모듈별 지연 시간이 누적됩니다.
+
+#ifndef INFERENCE_SESSION_H_
+#define INFERENCE_SESSION_H_
+
+#include <string>  // 문자열 처리를 위한 헤더 파일
+#include <vector>  // 벡터 컨테이너 라이브러리
+#include <torch/script.h>  // PyTorch 스크립트 API 관련 라이브러리
+#include <torch/torch.h>  // PyTorch 텐서 관련 라이브러리
+
+namespace fmfusion
+{
+
+// TorchScript 모듈 하나를 감싸는 추론 세션
+class InferenceModule
+{
+    public:
+        // 생성자: 지연 시간 보고에 쓰일 모듈 이름을 입력받음
+        InferenceModule(const std::string &name_="") :
+            name(name_), loaded(false), synchronize(false), calls(0), total_ms(0.0), max_ms(0.0) {};
+
+        ~InferenceModule() {};
+
+        /// \brief 모듈을 로드하고 장치로 옮긴 뒤 eval, freeze, optimize_for_inference를 적용합니다.
+        ///        freeze가 지원되지 않는 모듈은 최적화 없이 그대로 사용합니다.
+        /// \return 로드 성공 여부
+        bool load(const std::string &path, const std::string &device_string_, bool optimize=true);
+
+        /// \brief InferenceMode에서 forward를 실행하고 지연 시간을 누적합니다.
+        torch::jit::IValue forward(std::vector<torch::jit::IValue> inputs);
+
+        bool is_loaded() const { return loaded; }  // 로드 여부 반환
+        const std::string &get_name() const { return name; }  // 모듈 이름 반환
+
+        /// \brief CUDA 실행을 동기화하여 실제 커널 시간까지 측정할지 설정 (기본값은 비동기)
+        void set_synchronize(bool synchronize_) { synchronize = synchronize_; }
+
+        // 누적된 지연 시간을 문자열로 반환하는 함수 (호출 수, 평균, 최대)
+        std::string print_latency() const;
+
+        // 누적된 지연 시간 초기화
+        void reset_latency();
+
+    private:
+        std::string name;  // 모듈 이름
+        std::string device_string;  // 추론 장치 문자열
+        torch::jit::script::Module module;  // TorchScript 모듈
+        bool loaded;  // 로드 여부
+        bool synchronize;  // CUDA 동기화 여부
+
+        int calls;  // 호출 횟수
+        double total_ms;  // 누적 지연 시간
+        double max_ms;  // 최대 지연 시간
+};
+
+}
+
+#endif
@@ -30,7 +30,7 @@ namespace fmfusion
         // 그래프 준비
         src_graph->initialize(instances);  // 인스턴스로 그래프 초기화
         src_graph->construct_edges();  // 그래프의 엣지 생성
-        src_graph->construct_triplets();  // 그래프의 삼중항 생성
+        src_graph->construct_triplets(config.sgnet.triplet_number);  // 그래프의 삼중항 생성
         // fmfusion::DataDict src_data_dict = src_graph->extract_data_dict();  // 주석 처리된 코드
 
         return true;  // 성공적으로 초기화 완료
@@ -10,10 +10,12 @@ namespace fmfusion
                                 int cuda_number,
                                 std::vector<std::string> ref_graph_names):weight_folder_dir(weight_folder)
     {
-        shape_encoder = std::make_shared<ShapeEncoder>(shape_encoder_config, weight_folder, cuda_number);
+        // SGNet selects the device (cuda or cpu) and the shape encoder follows it
         sgnet = std::make_shared<SgNet>(sgnet_config, weight_folder, cuda_number);
+        device_string = sgnet->get_device_string();
+        shape_encoder = std::make_shared<ShapeEncoder>(shape_encoder_config, weight_folder, device_string);
+        shape_encoder->set_synchronize(sgnet_config.profile_latency);
         config = lcd_config;
-        cuda_device_string = "cuda:"+std::to_string(cuda_number);
 
         for(const auto &name: ref_graph_names){
             ref_graphs[name] = ImplicitGraph {};
@@ -28,23 +30,26 @@ namespace fmfusion
         int max_n = 120;
         int D0 = 128;
 
-        src_features.node_features = torch::zeros({max_n, D0}, torch::kFloat32).to(cuda_device_string);
+        src_features.node_features = torch::zeros({max_n, D0}, torch::kFloat32).to(device_string);
 
-        // ref_features.node_features = torch::zeros({max_n, D0}, torch::kFloat32).to(cuda_device_string);
+        // ref_features.node_features = torch::zeros({max_n, D0}, torch::kFloat32).to(device_string);
 
         for(auto &kv: ref_graphs){
-            kv.second.node_features = torch::zeros({max_n, D0}, torch::kFloat32).to(cuda_device_string);
+            kv.second.node_features = torch::zeros({max_n, D0}, torch::kFloat32).to(device_string);
         }
 
         std::cout<<"Initialize graph node features\n";
     }
 
-    bool LoopDetector::encode_scene_graph(const std::vector<NodePtr> &nodes, ImplicitGraph &graph_features)
+    bool LoopDetector::encode_scene_graph(const Graph &graph, ImplicitGraph &graph_features)
     {
+        c10::InferenceMode guard;
         open3d::utility::Timer timer;
         timer.Start();
-        sgnet->graph_encoder(nodes, graph_features.node_features);
+        sgnet->graph_encoder(graph, graph_features.node_features);
         timer.Stop();
+        std::cout<<"Encode scene graph on "<<device_string<<": "
+                <<std::fixed<<std::setprecision(1)<<timer.GetDurationInMillisecond()<<" ms\n";
         // if(!data_dict.nodes.empty()){ // Encode single graph shapes
         //     shape_encoder->encode(data_dict.xyz,data_dict.length_vec,data_dict.labels,data_dict.centroids,data_dict.nodes,
         //                             graph_features.shape_features, graph_features.node_knn_points, graph_features.node_knn_features);
@@ -59,23 +64,30 @@ namespace fmfusion
     }
 
     bool LoopDetector::encode_ref_scene_graph(const std::string &ref_name,
-                                            const std::vector<NodePtr> &nodes)
+                                            const Graph &graph)
     {
         if(ref_graphs.find(ref_name)==ref_graphs.end()){
             open3d::utility::LogWarning("Reference graph name not found. Skip encoding");
             return false;
         }
         ref_graphs[ref_name].shape_embedded = false;
-        return encode_scene_graph(nodes, ref_graphs[ref_name]);
+        invalidate_ref_pyramid(ref_name); // the dense ref points may have changed
+        return encode_scene_graph(graph, ref_graphs[ref_name]);
 
         // ref_features.shape_embedded = false;
         // return encode_scene_graph(nodes, ref_features);
     }
 
-    bool LoopDetector::encode_src_scene_graph(const std::vector<NodePtr> &nodes)
+    void LoopDetector::invalidate_ref_pyramid(const std::string &ref_name)
+    {
+        ref_pyramids.erase(ref_name);
+        ref_pyramid_versions.erase(ref_name);
+    }
+
+    bool LoopDetector::encode_src_scene_graph(const Graph &graph)
     {
         if(sgnet->is_online_bert()) sgnet->load_bert(weight_folder_dir);
-        bool ret = encode_scene_graph(nodes, src_features);
+        bool ret = encode_scene_graph(graph, src_features);
         src_features.shape_embedded = false;
         return ret;
     }
@@ -94,14 +106,16 @@ namespace fmfusion
             int N = coarse_features_vec.size();
             int D = coarse_features_vec[0].size();
             // std::cout<<"Update subscribed node features "<<N <<" x "<<D<<"\n";
-            float features_array[N][D];
+            torch::Tensor features = torch::empty({N,D}, torch::kFloat32); // heap buffer, written in place
+            float *features_ptr = features.data_ptr<float>();
             for(int i=0;i<N;i++){
-                std::copy(coarse_features_vec[i].begin(), coarse_features_vec[i].end(), features_array[i]);
+                assert(coarse_features_vec[i].size()==D);
+                std::copy(coarse_features_vec[i].begin(), coarse_features_vec[i].end(), features_ptr + i*D);
             }
-            ref_graphs[ref_name].node_features = torch::from_blob(features_array, {N,D}).to(torch::kFloat32).to(cuda_device_string);
+            ref_graphs[ref_name].node_features = sgnet->validate_features(features, "subscribed ref features").to(device_string);
             ref_sg_timestamps[ref_name] = cur_timestamp;
+            invalidate_ref_pyramid(ref_name);
 
-            assert(torch::isnan(ref_graphs[ref_name].node_features).sum().item<int>()==0);
             return true;
         }
         else{
@@ -116,52 +130,56 @@ namespace fmfusion
                                         bool fused,
                                         std::string hidden_feat_dir)
     {
+        c10::InferenceMode guard;
         encoding_time = 0.0;
         if(ref_graphs.find(ref_name)==ref_graphs.end()){
             open3d::utility::LogWarning("Reference graph name not found. Skip encoding");
             return false;
         }
 
-        // Concatenate data
-        std::vector<Eigen::Vector3d> xyz;
-        std::vector<int> length_vec;
-        std::vector<uint32_t> labels; // dense point instances
-        std::vector<Eigen::Vector3d> centroids;
         std::vector<uint32_t> nodes;
 
         o3d_utility::Timer timer;
-        std::stringstream msg;
 
-        timer.Start();
-        int Xr=ref_data_dict.xyz.size(), Xs=src_data_dict.xyz.size();
+        int Xr=ref_data_dict.point_number(), Xs=src_data_dict.point_number();
         if(Xr<1||Xs<1||Nr<1||Ns<1) return false;
         assert(Ns==src_features.node_features.size(0) && Nr==ref_graphs[ref_name].node_features.size(0));
 
-        xyz.insert(xyz.end(), ref_data_dict.xyz.begin(), ref_data_dict.xyz.end());
-        xyz.insert(xyz.end(), src_data_dict.xyz.begin(), src_data_dict.xyz.end());
-        length_vec = {Xr, Xs};
-
-        labels.insert(labels.end(), ref_data_dict.labels.begin(), ref_data_dict.labels.end());
-        std::vector<uint32_t> aligned_src_labels = src_data_dict.labels;
-        for(auto &l: aligned_src_labels) l+=Nr; // incorporate src label offset
-        labels.insert(labels.end(), aligned_src_labels.begin(), aligned_src_labels.end());
-
-        centroids.insert(centroids.end(), ref_data_dict.centroids.begin(), ref_data_dict.centroids.end());
-        centroids.insert(centroids.end(), src_data_dict.centroids.begin(), src_data_dict.centroids.end());
+        // The ref pyramid is cached per DataDict version, so any re-extraction of the ref points or
+        // labels rebuilds it. Dicts without a version are never cached. Only the src side is precomputed per query.
+        timer.Start();
+        StackPyramid &ref_pyramid = ref_pyramids[ref_name];
+        auto cached_version = ref_pyramid_versions.find(ref_name);
+        bool fresh = !ref_pyramid.empty() && ref_data_dict.version!=0
+                    && cached_version!=ref_pyramid_versions.end() && cached_version->second==ref_data_dict.version;
+        if(!fresh){
+            ref_pyramid_versions.erase(ref_name);
+            if(!shape_encoder->precompute_pyramid(ref_data_dict.xyz, std::vector<int>(1,Xr), ref_data_dict.labels,
+                                                ref_pyramid, true)){
+                ref_pyramids.erase(ref_name);
+                return false;
+            }
+            if(ref_data_dict.version!=0) ref_pyramid_versions[ref_name] = ref_data_dict.version;
+        }
+        StackPyramid src_pyramid, stack_pyramid;
+        if(!shape_encoder->precompute_pyramid(src_data_dict.xyz, std::vector<int>(1,Xs), src_data_dict.labels, src_pyramid))
+            return false;
+        shape_encoder->merge_pyramids(ref_pyramid, src_pyramid, Nr, stack_pyramid);
 
+        nodes.reserve(Nr+Ns);
         nodes.insert(nodes.end(), ref_data_dict.nodes.begin(), ref_data_dict.nodes.end());
-        std::vector<uint32_t> aligned_src_nodes = src_data_dict.nodes;
-        for(auto &n: aligned_src_nodes) n+=Nr; // incorporate src node offset
-        nodes.insert(nodes.end(), aligned_src_nodes.begin(), aligned_src_nodes.end());
+        for(const auto &n: src_data_dict.nodes) nodes.push_back(n+Nr); // incorporate src node offset
+        timer.Stop();
 
-        std::cout<<"Concat ref and src scene graphs: "<<Xr<<" + "<<Xs<<" = "<<Xr+Xs<<std::endl;
+        std::cout<<"Concat ref and src scene graphs: "<<Xr<<" + "<<Xs<<" = "<<Xr+Xs
+                <<" in "<<std::fixed<<std::setprecision(1)<<timer.GetDurationInMillisecond()<<" ms"<<std::endl;
 
         // Encode shape features
         torch::Tensor stack_shape_features;
         torch::Tensor stack_node_knn_points;
         torch::Tensor stack_node_knn_features;
 
-        shape_encoder->encode(xyz, length_vec, labels, centroids, nodes,
+        shape_encoder->encode_pyramid(stack_pyramid, nodes, Nr+Ns,
                             stack_shape_features, 
                             stack_node_knn_points, stack_node_knn_features, 
                             encoding_time,
@@ -171,14 +189,14 @@ namespace fmfusion
         assert(stack_node_knn_points.size(0)==Nr+Ns);
 
         src_features.shape_embedded = true;
-        src_features.shape_features = stack_shape_features.index({torch::arange(Nr,Nr+Ns).to(torch::kInt64).to(cuda_device_string)});
-        src_features.node_knn_points = stack_node_knn_points.index({torch::arange(Nr,Nr+Ns).to(torch::kInt64).to(cuda_device_string)});
-        src_features.node_knn_features = stack_node_knn_features.index({torch::arange(Nr,Nr+Ns).to(torch::kInt64).to(cuda_device_string)});
+        src_features.shape_features = stack_shape_features.index({torch::arange(Nr,Nr+Ns).to(torch::kInt64).to(device_string)});
+        src_features.node_knn_points = stack_node_knn_points.index({torch::arange(Nr,Nr+Ns).to(torch::kInt64).to(device_string)});
+        src_features.node_knn_features = stack_node_knn_features.index({torch::arange(Nr,Nr+Ns).to(torch::kInt64).to(device_string)});
 
         ref_graphs[ref_name].shape_embedded = true;
-        ref_graphs[ref_name].shape_features = stack_shape_features.index({torch::arange(0,Nr).to(torch::kInt64).to(cuda_device_string)});
-        ref_graphs[ref_name].node_knn_points = stack_node_knn_points.index({torch::arange(0,Nr).to(torch::kInt64).to(cuda_device_string)});
-        ref_graphs[ref_name].node_knn_features = stack_node_knn_features.index({torch::arange(0,Nr).to(torch::kInt64).to(cuda_device_string)});
+        ref_graphs[ref_name].shape_features = stack_shape_features.index({torch::arange(0,Nr).to(torch::kInt64).to(device_string)});
+        ref_graphs[ref_name].node_knn_points = stack_node_knn_points.index({torch::arange(0,Nr).to(torch::kInt64).to(device_string)});
+        ref_graphs[ref_name].node_knn_features = stack_node_knn_features.index({torch::arange(0,Nr).to(torch::kInt64).to(device_string)});
 
         return true;
     }
@@ -188,22 +206,19 @@ namespace fmfusion
                                 std::vector<float> &match_scores,
                                 bool fused, std::string dir)
     {   
+        c10::InferenceMode guard;
         if(ref_graphs.find(ref_name)==ref_graphs.end()){
             open3d::utility::LogWarning("Reference graph name not found. Skip matching");
             return 0;
         }
-        bool ref_shape_embedded = ref_graphs[ref_name].shape_embedded;
-        torch::Tensor ref_gnn_features = ref_graphs[ref_name].node_features.clone();
-
-        bool check_ref_nodes = torch::isnan(ref_gnn_features).sum().item<int>()==0;
-        assert (check_ref_nodes);
+        const ImplicitGraph &ref_graph = ref_graphs[ref_name];
+        torch::Tensor ref_gnn_features = ref_graph.node_features; // read only, no clone needed. SGNet validates it
 
         torch::Tensor src_node_features , ref_node_features;
         bool check_fused = false;
-        if(src_features.shape_embedded && ref_shape_embedded){
-            torch::Tensor ref_shape_features = ref_graphs[ref_name].shape_features.clone();
-            src_node_features = torch::cat({src_features.node_features.clone(), src_features.shape_features.clone()}, 1);
-            ref_node_features = torch::cat({ref_gnn_features, ref_shape_features}, 1);
+        if(src_features.shape_embedded && ref_graph.shape_embedded){
+            src_node_features = torch::cat({src_features.node_features, src_features.shape_features}, 1);
+            ref_node_features = torch::cat({ref_gnn_features, ref_graph.shape_features}, 1);
             check_fused = true;
         }
         else{
@@ -223,6 +238,53 @@ namespace fmfusion
         return match_pairs.size();
     }
 
+    int LoopDetector::match_nodes_batch(const std::vector<std::string> &ref_names,
+                                        std::vector<std::vector<std::pair<uint32_t,uint32_t>>> &match_pairs,
+                                        std::vector<std::vector<float>> &match_scores)
+    {
+        c10::InferenceMode guard;
+        match_pairs.assign(ref_names.size(), {});
+        match_scores.assign(ref_names.size(), {});
+
+        std::vector<int> slots;
+        std::vector<torch::Tensor> src_list, ref_list;
+        std::vector<bool> fused_list;
+        torch::Tensor src_fused_features; // shared by every fused ref
+        for(int k=0;k<ref_names.size();k++){
+            auto it = ref_graphs.find(ref_names[k]);
+            if(it==ref_graphs.end()){
+                open3d::utility::LogWarning("Reference graph {} not found. Skip matching", ref_names[k]);
+                continue;
+            }
+            const ImplicitGraph &ref_graph = it->second;
+            bool fused = src_features.shape_embedded && ref_graph.shape_embedded;
+            if(fused){
+                if(!src_fused_features.defined())
+                    src_fused_features = torch::cat({src_features.node_features, src_features.shape_features}, 1);
+                src_list.push_back(src_fused_features);
+                ref_list.push_back(torch::cat({ref_graph.node_features, ref_graph.shape_features}, 1));
+            }
+            else{
+                src_list.push_back(src_features.node_features);
+                ref_list.push_back(ref_graph.node_features);
+            }
+            fused_list.push_back(fused);
+            slots.push_back(k);
+        }
+
+        std::vector<std::vector<std::pair<uint32_t,uint32_t>>> batch_pairs;
+        std::vector<std::vector<float>> batch_scores;
+        sgnet->match_nodes_batch(src_list, ref_list, fused_list, batch_pairs, batch_scores);
+
+        int count = 0;
+        for(int b=0;b<slots.size();b++){
+            count += batch_pairs[b].size();
+            match_pairs[slots[b]] = std::move(batch_pairs[b]);
+            match_scores[slots[b]] = std::move(batch_scores[b]);
+        }
+        return count;
+    }
+
     int LoopDetector::match_instance_points(const std::string &ref_name,
                                             const std::vector<std::pair<uint32_t,uint32_t>> &match_pairs,
                                             std::vector<Eigen::Vector3d> &corr_src_points,
@@ -231,6 +293,18 @@ namespace fmfusion
                                             std::vector<float> &corr_scores_vec,
                                             std::string dir)
     {
+        CorrespondenceBuffer corr;
+        int C = match_instance_points(ref_name, match_pairs, corr, dir);
+        corr.append_to(corr_src_points, corr_ref_points, corr_match_indices, corr_scores_vec);
+        return C;
+    }
+
+    int LoopDetector::match_instance_points(const std::string &ref_name,
+                                            const std::vector<std::pair<uint32_t,uint32_t>> &match_pairs,
+                                            CorrespondenceBuffer &corr,
+                                            std::string dir)
+    {
+        c10::InferenceMode guard;
 
         if(ref_graphs.find(ref_name)==ref_graphs.end()){
             open3d::utility::LogWarning("Reference graph name not found. Skip matching");
@@ -242,47 +316,47 @@ namespace fmfusion
         }
 
         int M = match_pairs.size();
-        float match_pairs_array[2][M]; //
+        if(M<1) return 0;
+        std::vector<int64_t> src_nodes_vec(M), ref_nodes_vec(M);
         for(int i=0;i<M;i++){
-            match_pairs_array[0][i] = int(match_pairs[i].first);  // src_node
-            match_pairs_array[1][i] = int(match_pairs[i].second); // ref_node
-        }
-
-        torch::Tensor src_corr_nodes = torch::from_blob(match_pairs_array[0], {M}).to(torch::kInt64).to(cuda_device_string);
-        torch::Tensor ref_corr_nodes = torch::from_blob(match_pairs_array[1], {M}).to(torch::kInt64).to(cuda_device_string);
-
-        //
-        if(!src_features.shape_embedded || !ref_graphs[ref_name].shape_embedded){
-            open3d::utility::LogWarning("No node knn points. Skip point matching");
-            return 0;
+            src_nodes_vec[i] = match_pairs[i].first;  // src_node
+            ref_nodes_vec[i] = match_pairs[i].second; // ref_node
         }
-
-        torch::Tensor src_guided_knn_points = src_features.node_knn_points.index_select(0, src_corr_nodes);
-        torch::Tensor src_guided_knn_feats = src_features.node_knn_features.index_select(0, src_corr_nodes);
-        torch::Tensor ref_guided_knn_points = ref_graphs[ref_name].node_knn_points.index_select(0, ref_corr_nodes);
-        torch::Tensor ref_guided_knn_feats = ref_graphs[ref_name].node_knn_features.index_select(0, ref_corr_nodes);
-        if(M>30)
-            open3d::utility::LogWarning(
-                                    "Large number of points candidates. Point match can cost >10GB memory on GPU");
-        
-        assert(src_guided_knn_feats.size(0)>0 && ref_guided_knn_feats.size(0)>0);
-        assert(src_guided_knn_feats.size(1)==512 && ref_guided_knn_feats.size(1)==512);
-
-        // torch::Tensor corr_points;
-        int C = sgnet->match_points(src_guided_knn_feats, 
+        torch::Tensor src_corr_nodes = torch::from_blob(src_nodes_vec.data(), {M}, torch::kInt64).to(device_string);
+        torch::Tensor ref_corr_nodes = torch::from_blob(ref_nodes_vec.data(), {M}, torch::kInt64).to(device_string);
+        const ImplicitGraph &ref_features = ref_graphs[ref_name];
+        assert(src_features.node_knn_features.size(1)==512 && ref_features.node_knn_features.size(1)==512);
+
+        // Each pair is matched independently, so the pairs are processed in chunks
+        // bounded by the memory budget and the correspondences are appended chunk by chunk.
+        int chunk_size = M;
+        if(config.point_match_memory_mb>0)
+            chunk_size = std::max(1, int(config.point_match_memory_mb / POINT_MATCH_MB_PER_PAIR));
+        int C = 0;
+        for(int start=0;start<M;start+=chunk_size){
+            int chunk = std::min(chunk_size, M-start);
+            torch::Tensor src_chunk_nodes = src_corr_nodes.narrow(0, start, chunk);
+            torch::Tensor ref_chunk_nodes = ref_corr_nodes.narrow(0, start, chunk);
+            torch::Tensor src_guided_knn_points = src_features.node_knn_points.index_select(0, src_chunk_nodes);
+            torch::Tensor src_guided_knn_feats = src_features.node_knn_features.index_select(0, src_chunk_nodes);
+            torch::Tensor ref_guided_knn_points = ref_features.node_knn_points.index_select(0, ref_chunk_nodes);
+            torch::Tensor ref_guided_knn_feats = ref_features.node_knn_features.index_select(0, ref_chunk_nodes);
+            TORCH_CHECK(src_guided_knn_feats.device()==torch::Device(device_string), "src guided knn feats must be on ", device_string);
+
+            C += sgnet->match_points(src_guided_knn_feats, 
                                     ref_guided_knn_feats, 
                                     src_guided_knn_points,
                                     ref_guided_knn_points,
-                                    corr_src_points,
-                                    corr_ref_points,
-                                    corr_match_indices,
-                                    corr_scores_vec);
-
-        TORCH_CHECK(src_guided_knn_feats.device().is_cuda(), "src guided knn feats must be a CUDA tensor");
+                                    corr,
+                                    start);
+        }
+        if(chunk_size<M)
+            std::cout<<"Match points of "<<M<<" node pairs in chunks of "<<chunk_size<<"\n";
 
         if(dir!=""){
             std::string output_file_dir = dir+"_knn_points.pt";
-            torch::save({src_guided_knn_feats, ref_guided_knn_feats},
+            torch::save({src_features.node_knn_features.index_select(0, src_corr_nodes),
+                         ref_features.node_knn_features.index_select(0, ref_corr_nodes)},
                             output_file_dir);
         }
 
@@ -316,6 +390,15 @@ namespace fmfusion
         return true;
     }
 
+    std::string LoopDetector::print_inference_latency() const
+    {
+        std::stringstream msg;
+        msg<<"Inference latency on "<<device_string<<":\n"
+            <<sgnet->print_latency()
+            <<shape_encoder->print_latency();
+        return msg.str();
+    }
+
     bool LoopDetector::save_middle_features(const std::string &dir)
     {
         std::cout<<"Saving middle features to "<<dir<<"\n";
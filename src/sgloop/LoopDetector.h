@@ -8,6 +8,10 @@
 
 namespace fmfusion
 {
+    // Approximate peak memory of the point match layer per node pair (512x512 knn points).
+    // Measured as >10GB for 30 pairs on GPU.
+    const float POINT_MATCH_MB_PER_PAIR = 350.0;
+
     struct ImplicitGraph{
         torch::Tensor node_features; // (N, D0)
         torch::Tensor shape_features; // (N, D1)
@@ -29,11 +33,11 @@ namespace fmfusion
 
         /// \brief  Encode the reference scene graph. 
         /// If \param data_dict is empty, it only run triplet gnn and skip dense point cloud encoding.
-        bool encode_ref_scene_graph(const std::string &ref_name, const std::vector<NodePtr> &nodes);
+        bool encode_ref_scene_graph(const std::string &ref_name, const Graph &graph);
 
         /// \brief  Encode the source scene graph. 
         /// If \param data_dict is empty, it only run triplet gnn and skip dense point cloud encoding.
-        bool encode_src_scene_graph(const std::vector<NodePtr> &nodes);
+        bool encode_src_scene_graph(const Graph &graph);
 
         /// \brief Update the ref sg features from subscribed com server.
         bool subscribe_ref_coarse_features(const std::string &ref_name,
@@ -50,18 +54,32 @@ namespace fmfusion
                                 bool fused=false,
                                 std::string hidden_feat_dir="");
 
+        /// \brief Drop the cached shape pyramid of a ref graph. Call it whenever the dense ref
+        ///        points or labels are updated outside encode_ref_scene_graph.
+        void invalidate_ref_pyramid(const std::string &ref_name);
+
         int match_nodes(const std::string &ref_name,
                         std::vector<std::pair<uint32_t,uint32_t>> &match_pairs,
                         std::vector<float> &match_scores,
                         bool fused=false,
                         std::string dir="");
 
+        /// \brief  Match the src graph against several ref graphs. The match layers are launched
+        ///         back to back and their results are copied to the host once.
+        /// \param  match_pairs   One list per ref name. Unknown ref names get an empty list.
+        /// \return The total number of matched node pairs.
+        int match_nodes_batch(const std::vector<std::string> &ref_names,
+                            std::vector<std::vector<std::pair<uint32_t,uint32_t>>> &match_pairs,
+                            std::vector<std::vector<float>> &match_scores);
+
         /// \brief  Match the points of the corresponding instances.
         /// \param  match_pairs         The matched node pairs.
         /// \param  corr_src_points     (C,3) The corresponding points in the source instance.
         /// \param  corr_ref_points     (C,3) The corresponding points in the reference instance.
         /// \param  corr_match_indices  (C,) The indices of the matched node pairs.
         /// \param  corr_scores_vec     (C,) The matching scores of each point correspondence.
+        /// \note   The pairs are matched in chunks bounded by LoopDetector.point_match_memory_mb,
+        ///         and the correspondences of each chunk are appended to the output vectors.
         int match_instance_points(const std::string &ref_name,
                                 const std::vector<std::pair<uint32_t,uint32_t>> &match_pairs,
                                 std::vector<Eigen::Vector3d> &corr_src_points,
@@ -70,6 +88,13 @@ namespace fmfusion
                                 std::vector<float> &corr_scores_vec,
                                 std::string dir="");
 
+        /// \brief  Match the points of the corresponding instances into a contiguous buffer.
+        ///         The (C,3) point matrices can be passed to G3RegAPI without conversion.
+        int match_instance_points(const std::string &ref_name,
+                                const std::vector<std::pair<uint32_t,uint32_t>> &match_pairs,
+                                CorrespondenceBuffer &corr,
+                                std::string dir="");
+
         // void clear();
 
         torch::Tensor get_active_node_feats()const{
@@ -116,14 +141,21 @@ namespace fmfusion
 
         bool save_middle_features(const std::string &dir);
 
+        /// \brief Accumulated latency of every TorchScript module (calls, mean, max).
+        std::string print_inference_latency() const;
+
+        /// \brief Save the BERT label embedding cache to SGNet.label_embedding_cache, so that
+        ///        the next run only encodes labels it has not seen.
+        bool save_label_embeddings() const { return sgnet->save_label_embeddings(); }
+
     private:
-        bool encode_scene_graph(const std::vector<NodePtr> &nodes, ImplicitGraph &graph_features);
+        bool encode_scene_graph(const Graph &graph, ImplicitGraph &graph_features);
 
         /// @brief  Reserve the features memories on GPU. 
         void initialize_graph_features();
 
     private:
-        std::string cuda_device_string;
+        std::string device_string;
         ImplicitGraph src_features;    
         std::unordered_map<std::string, ImplicitGraph> ref_graphs;
         std::unordered_map<std::string, float> ref_sg_timestamps; // The latest received sg frame id
@@ -133,6 +165,11 @@ namespace fmfusion
         std::shared_ptr<SgNet> sgnet;
         std::string weight_folder_dir;
 
+        // Cached stack-mode pyramid of each ref graph, merged with the src pyramid per query.
+        // It is keyed on the DataDict version it was built from.
+        std::unordered_map<std::string, StackPyramid> ref_pyramids;
+        std::unordered_map<std::string, uint64_t> ref_pyramid_versions;
+
     };
     
 } // namespace fmfusion
@@ -1,9 +1,30 @@
+#include <unordered_set>
 #include "SGNet.h"
 
 
 namespace fmfusion
 {
 
+// (C,3) 텐서를 열 우선 double 행렬의 row_offset 행부터 복사. 장치에서 double로 변환 후 한 번만 복사
+static void copy_points_to_matrix(const torch::Tensor &points, Eigen::MatrixX3d &matrix, int row_offset)
+{
+    int C = points.size(0);
+    if (C == 0) return;
+    torch::Tensor dst = torch::from_blob(matrix.data() + row_offset, {3, C}, {matrix.rows(), 1}, torch::kFloat64);
+    dst.copy_(points.to(torch::kFloat64).t());
+}
+
+// (C,3) 텐서를 Eigen::Vector3d 벡터 뒤에 추가. Vector3d는 double 3개가 연속이므로 한 번에 복사
+static void append_points_to_vector(const torch::Tensor &points, std::vector<Eigen::Vector3d> &vec)
+{
+    int C = points.size(0);
+    if (C == 0) return;
+    size_t offset = vec.size();
+    vec.resize(offset + C);
+    torch::Tensor dst = torch::from_blob(vec[offset].data(), {C, 3}, torch::kFloat64);
+    dst.copy_(points.to(torch::kFloat64));
+}
+
 // 일치하는 포인트 추출 함수
 int extract_corr_points(const torch::Tensor &src_guided_knn_points, // (N,K,3)
                         const torch::Tensor &ref_guided_knn_points,
@@ -12,44 +33,13 @@ int extract_corr_points(const torch::Tensor &src_guided_knn_points, // (N,K,3)
                         std::vector<Eigen::Vector3d> &corr_ref_points)
 {
     int C = corr_points.size(0);  // 일치하는 포인트의 개수 (C)
-    if(C > 0){
+    if (C > 0) {
         using namespace torch::indexing;
-        
-        // 일치하는 포인트의 인덱스를 추출
-        torch::Tensor corr_match_indices = corr_points.index(
-                                        {"...", 0}).to(torch::kInt32); // (C,)
-        torch::Tensor corr_src_indices = corr_points.index(
-                                        {"...", 1}).to(torch::kInt32); // (C)
-        torch::Tensor corr_ref_indices = corr_points.index(
-                                        {"...", 2}).to(torch::kInt32); // (C)
-        
-        // 인덱스가 범위 내에 있는지 확인
-        assert(corr_match_indices.max() < src_guided_knn_points.size(0));
-        assert(corr_src_indices.max() < src_guided_knn_points.size(1));
-        assert(corr_ref_indices.max() < ref_guided_knn_points.size(1));
-
-        // 일치하는 포인트의 좌표를 추출
-        torch::Tensor corr_src_points_t = src_guided_knn_points.index(
-                                        {corr_match_indices, corr_src_indices}).to(torch::kFloat32); // (C,3)
-        torch::Tensor corr_ref_points_t = ref_guided_knn_points.index(
-                                        {corr_match_indices, corr_ref_indices}).to(torch::kFloat32); // (C,3)
-        
-        // CPU로 이동하여 벡터 형태로 변환
-        corr_src_points_t = corr_src_points_t.to(torch::kCPU);
-        corr_ref_points_t = corr_ref_points_t.to(torch::kCPU);
-
-        auto corr_src_points_a = corr_src_points_t.accessor<float, 2>();
-        auto corr_ref_points_a = corr_ref_points_t.accessor<float, 2>();
-        
-        // 일치하는 포인트의 좌표를 Eigen::Vector3d 형태로 변환하여 벡터에 저장
-        for (int i = 0; i < C; i++){
-            corr_src_points.push_back({corr_src_points_a[i][0],
-                                        corr_src_points_a[i][1],
-                                        corr_src_points_a[i][2]});
-            corr_ref_points.push_back({corr_ref_points_a[i][0],
-                                        corr_ref_points_a[i][1],
-                                        corr_ref_points_a[i][2]});
-        }
+        torch::Tensor corr_match_indices = corr_points.index({"...", 0});  // (C,)
+        torch::Tensor corr_src_indices = corr_points.index({"...", 1});  // (C)
+        torch::Tensor corr_ref_indices = corr_points.index({"...", 2});  // (C)
+        append_points_to_vector(src_guided_knn_points.index({corr_match_indices, corr_src_indices}), corr_src_points);
+        append_points_to_vector(ref_guided_knn_points.index({corr_match_indices, corr_ref_indices}), corr_ref_points);
     }
     return C;  // 일치하는 포인트의 개수 반환
 }
@@ -57,11 +47,33 @@ int extract_corr_points(const torch::Tensor &src_guided_knn_points, // (N,K,3)
 
 int check_nan_features(const torch::Tensor &features) 
 {
-    // 각 특징에 대해 NaN 값을 체크하고, 각 특성의 NaN 개수를 더함
-    auto check_feat = torch::sum(torch::isnan(features), 1); // (N,)
-    int N = features.size(0);  // 특징의 개수
-    int wired_nodes = torch::sum(check_feat > 0).item<int>();  // NaN 값이 있는 특징을 가진 노드 수 계산
-    return wired_nodes;  // NaN 특징이 있는 노드 수 반환
+    // NaN 값이 있는 노드 수를 하나의 연산으로 계산 (호스트 동기화 1회)
+    return torch::isnan(features).any(1).sum().item<int>();
+}
+
+torch::Tensor sanitize_nan_features(const torch::Tensor &features)
+{
+    return features.masked_fill(torch::isnan(features), 0);
+}
+
+std::string configure_torch_backend(const SgNetConfig &config, int cuda_number)
+{
+    std::string device_string = "cpu";
+    if (config.device == "cuda") {
+        if (torch::cuda::is_available()) device_string = "cuda:" + std::to_string(cuda_number);
+        else open3d::utility::LogWarning("CUDA is not available. Run SGNet on cpu");
+    }
+    else if (config.device != "cpu")
+        open3d::utility::LogWarning("Unknown device {}. Run SGNet on cpu", config.device);
+
+    if (device_string == "cpu") {
+        // CPU 경로: 연산자 내부 스레드 수와 oneDNN 융합 설정 (프로세스 전역)
+        if (config.intra_op_threads > 0) torch::set_num_threads(config.intra_op_threads);
+        torch::jit::RegisterLlgaFuseGraph::setEnabled(config.onednn_fusion);
+        std::cout << "CPU inference with " << torch::get_num_threads() << " intra-op threads"
+                  << (config.onednn_fusion ? ", oneDNN fusion enabled" : "") << "\n";
+    }
+    return device_string;
 }
 
 SgNet::SgNet(const SgNetConfig &config_, const std::string weight_folder, int cuda_number) : config(config_)
@@ -74,96 +86,240 @@ SgNet::SgNet(const SgNetConfig &config_, const std::string weight_folder, int cu
     std::string instance_match_fused_path = weight_folder + "/instance_match_fused.pt";
     std::string point_match_path = weight_folder + "/point_match_layer.pt";
 
-    // CUDA 장치 설정
-    cuda_device_string = "cuda:" + std::to_string(cuda_number);
-    std::cout << "Initializing SGNet on " << cuda_device_string << "\n";
-    torch::Device device(torch::kCUDA, cuda_number);
+    // 추론 장치 설정
+    device_string = configure_torch_backend(config, cuda_number);
+    std::cout << "Initializing SGNet on " << device_string << "\n";
+    torch::Device device(device_string);
 
-    // SGNet 모델 로드
-    try {
-        sgnet_lt = torch::jit::load(sgnet_path);  // SGNet 모델 로드
-        sgnet_lt.to(device);  // CUDA 장치로 이동
-        std::cout << "Load encoder from " << sgnet_path
-                  << " on device " << cuda_device_string << std::endl;
-        sgnet_lt.eval();  // 평가 모드로 설정
-        torch::jit::optimize_for_inference(sgnet_lt);  // 추론 최적화
+    // 모델 로드. 모듈마다 별도 쓰레드에서 로드하고, eval, freeze, optimize_for_inference가 적용됨
+    o3d_utility::Timer timer;
+    timer.Start();
+    std::vector<std::future<bool>> module_loads;
+    auto load_async = [this, &module_loads](InferenceModule &module, const std::string &path) {
+        module_loads.emplace_back(std::async(std::launch::async,
+                                             [this, &module, path]() { return module.load(path, device_string); }));
+    };
+    load_async(sgnet_lt, sgnet_path);  // SGNet 모델 로드
+    load_async(bert_encoder, bert_path);  // BERT 모델 로드
+    load_async(light_match_layer, instance_match_light_path);  // 라이트 매칭 레이어 로드
+    load_async(fused_match_layer, instance_match_fused_path);  // 융합 매칭 레이어 로드
+    load_async(point_match_layer, point_match_path);  // 포인트 매칭 레이어 로드
+
+    // BertBow 로드
+    bert_bow_ptr = std::make_shared<BertBow>(weight_folder + "/bert_bow.txt",
+                                             weight_folder + "/bert_bow.pt", device.is_cuda());
+    enable_bert_bow = bert_bow_ptr->is_loaded();  // BertBow 로드 여부 확인
+    bert_bow_ptr->set_unknown_word_encoder(  // BertBow에 없는 단어는 BERT로 인코딩
+        [this](const std::vector<std::string> &words, torch::Tensor &features) { return bert_encode(words, features); });
+    std::cout << "Enable bert bow: " << enable_bert_bow << "\n";
+
+    // 토크나이저 로드 및 초기화
+    tokenizer.reset(radish::TextTokenizerFactory::Create("radish::BertTokenizer"));  // BERT 토크나이저 생성
+    tokenizer->SetCacheDir(config.tokenizer_cache_dir);  // 전처리된 어휘 사전 캐시 (설정된 경우만)
+    tokenizer->Init(vocab_path);  // 어휘 파일로 초기화
+    std::cout << "Tokenizer loaded and initialized\n";
+
+    // 모듈 로드 대기
+    for (auto &module_load : module_loads) module_load.get();
+    for (InferenceModule *module : {&bert_encoder, &sgnet_lt, &light_match_layer, &fused_match_layer, &point_match_layer})
+        module->set_synchronize(config.profile_latency);  // 프로파일링 시 CUDA 커널 시간까지 측정
+    timer.Stop();
+    std::cout << "Load SGNet modules time cost (ms): " << timer.GetDurationInMillisecond() << "\n";
+
+    // 이전 실행에서 저장한 라벨 임베딩 캐시 로드
+    if (!enable_bert_bow && !config.label_embedding_cache.empty()
+        && std::ifstream(config.label_embedding_cache + ".pt").good())
+        load_label_embeddings(config.label_embedding_cache + ".txt", config.label_embedding_cache + ".pt");
+
+    // 워밍업은 백그라운드에서 수행. 첫 추론 호출만 워밍업이 끝날 때까지 대기
+    if (config.warm_up_iter > 0 && sgnet_lt.is_loaded())
+        warm_up_future = std::async(std::launch::async, [this]() { warm_up(config.warm_up_iter, true); }).share();
+}
+
+SgNet::~SgNet()
+{
+    wait_warm_up();  // 워밍업 쓰레드가 멤버를 사용하므로 종료 전에 대기
+}
+
+void SgNet::wait_warm_up() const
+{
+    if (warm_up_future.valid()) warm_up_future.wait();
+}
+
+bool SgNet::update_label_embeddings(const std::vector<std::string> &labels)
+{
+    // 새 라벨 수집 (중복 제거)
+    std::vector<std::string> new_labels;
+    std::unordered_set<std::string> new_label_set;
+    for (const std::string &label : labels) {
+        if (label_embedding_index.count(label) || new_label_set.count(label)) continue;
+        new_label_set.insert(label);
+        new_labels.push_back(label);
     }
-    catch (const c10::Error& e) {
-        std::cerr << "Error loading the model\n";  // 모델 로딩 실패 시 오류 메시지 출력
+    int U = new_labels.size();  // 새 라벨 수
+    if (U == 0) return true;
+
+    torch::Tensor new_embeddings;
+    if (!bert_encode(new_labels, new_embeddings)) return false;
+    append_label_embeddings(new_labels, new_embeddings);
+    std::cout << "Encode " << U << " new labels with BERT. "
+              << label_embedding_number << " labels cached\n";
+    return true;
+}
+
+bool SgNet::bert_encode(const std::vector<std::string> &labels, torch::Tensor &embeddings)
+{
+    wait_warm_up();  // 백그라운드 워밍업이 끝날 때까지 대기
+    c10::InferenceMode guard;  // 추론 모드 (autograd 기록 없음)
+    int U = labels.size();  // 라벨 수
+    if (!bert_encoder.is_loaded()) {
+        open3d::utility::LogWarning("BERT is not loaded. Cannot encode {:d} labels", U);
+        return false;
     }
 
-    // BERT 인코더 로드
-    try {
-        bert_encoder = torch::jit::load(bert_path);  // BERT 모델 로드
-        bert_encoder.to(device);  // CUDA 장치로 이동
-        std::cout << "Load bert from " << bert_path << std::endl;
+    // 토큰화. 토큰 버퍼는 호출 간에 재사용
+    const int T = config.token_padding;  // 토큰 패딩 길이
+    token_buffer.assign(U * T, 0);
+    token_mask_buffer.assign(U * T, 0);
+    for (int i = 0; i < U; i++) {
+        std::vector<int> label_tokens = tokenizer->Encode(labels[i]);  // 라벨을 토큰화
+        int32_t *tokens = token_buffer.data() + i * T;
+        int32_t *tokens_attention_mask = token_mask_buffer.data() + i * T;
+        tokens[0] = 101;  // 시작 토큰
+        int k = 1;
+        for (auto token : label_tokens) {
+            if (k >= T - 1) break;  // 패딩 길이를 넘는 토큰은 잘라냄
+            tokens[k] = token;  // 토큰 저장
+            k++;
+        }
+        tokens[k] = 102;  // 종료 토큰
+        std::fill(tokens_attention_mask, tokens_attention_mask + k + 1, 1);  // 어텐션 마스크 설정
     }
-    catch (const std::exception& e) {
-        std::cerr << e.what() << '\n';  // BERT 모델 로딩 실패 시 오류 메시지 출력
+
+    torch::Tensor input_ids = torch::from_blob(token_buffer.data(), {U, T}, torch::kInt32).to(device_string);  // 입력 ID 텐서
+    torch::Tensor attention_mask = torch::from_blob(token_mask_buffer.data(), {U, T}, torch::kInt32).to(device_string);  // 어텐션 마스크 텐서
+    torch::Tensor token_type_ids = torch::zeros({U, T}, torch::kInt32).to(device_string);  // 토큰 타입 ID 텐서
+    embeddings = bert_encoder.forward({input_ids, attention_mask, token_type_ids}).toTensor();  // BERT 인코더 실행
+    return true;
+}
+
+void SgNet::append_label_embeddings(const std::vector<std::string> &new_labels, const torch::Tensor &new_embeddings)
+{
+    int64_t U = new_labels.size();
+    int64_t D = new_embeddings.size(1);
+    assert(new_embeddings.size(0) == U);
+
+    // 용량이 부족하면 두 배로 늘린 장치 텐서로 옮김
+    int64_t capacity = label_embeddings.defined() ? label_embeddings.size(0) : 0;
+    if (label_embedding_number + U > capacity) {
+        int64_t new_capacity = std::max<int64_t>({2 * capacity, label_embedding_number + U, 64});
+        torch::Tensor grown = torch::zeros({new_capacity, D}, new_embeddings.options());
+        if (label_embedding_number > 0)
+            grown.narrow(0, 0, label_embedding_number).copy_(label_embeddings.narrow(0, 0, label_embedding_number));
+        label_embeddings = grown;
     }
+    label_embeddings.narrow(0, label_embedding_number, U).copy_(new_embeddings.to(label_embeddings.device()));
 
-    // 라이트 매칭 레이어 로드
-    try {
-        light_match_layer = torch::jit::load(instance_match_light_path);  // 라이트 매칭 레이어 로드
-        light_match_layer.to(device);  // CUDA 장치로 이동
-        std::cout << "Load light match layer from " << instance_match_light_path << std::endl;
+    for (int64_t i = 0; i < U; i++) label_embedding_index[new_labels[i]] = label_embedding_number + i;
+    label_embedding_number += U;
+}
+
+bool SgNet::load_label_embeddings(const std::string &labels_file, const std::string &features_file)
+{
+    c10::InferenceMode guard;  // 추론 모드 (autograd 기록 없음)
+    std::ifstream file(labels_file, std::ifstream::in);
+    if (!file.is_open()) {
+        std::cerr << "Error: cannot open file " << labels_file << std::endl;
+        return false;
     }
-    catch (const std::exception& e) {
-        std::cerr << e.what() << '\n';  // 라이트 매칭 레이어 로딩 실패 시 오류 메시지 출력
+    std::vector<std::string> cached_labels;
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t dot = line.find(".");
+        if (dot == std::string::npos) continue;
+        int index = std::stoi(line.substr(0, dot));  // 인덱스 추출
+        if (index != cached_labels.size()) {
+            std::cerr << "Error: label embedding index is not continuous in " << labels_file << std::endl;
+            return false;
+        }
+        cached_labels.push_back(line.substr(dot + 1));  // 라벨 추출
     }
 
-    // 융합 매칭 레이어 로드
+    torch::Tensor cached_embeddings;
     try {
-        fused_match_layer = torch::jit::load(instance_match_fused_path);  // 융합 매칭 레이어 로드
-        fused_match_layer.to(device);  // CUDA 장치로 이동
-        std::cout << "Load fused match layer from " << instance_match_fused_path << std::endl;
+        std::vector<char> bytes = get_the_bytes(features_file);  // 파일에서 바이트 읽기
+        cached_embeddings = torch::pickle_load(bytes).toTensor();
     }
-    catch (const std::exception& e) {
-        std::cerr << e.what() << '\n';  // 융합 매칭 레이어 로딩 실패 시 오류 메시지 출력
+    catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return false;
     }
-
-    // 포인트 매칭 레이어 로드
-    try {
-        point_match_layer = torch::jit::load(point_match_path);  // 포인트 매칭 레이어 로드
-        point_match_layer.to(device);  // CUDA 장치로 이동
-        std::cout << "Load point match layer from " << point_match_path << std::endl;
+    if (cached_embeddings.dim() != 2 || cached_embeddings.size(0) != cached_labels.size()) {
+        std::cerr << "Error: label embeddings do not match " << labels_file << std::endl;
+        return false;
     }
-    catch (const std::exception& e) {
-        std::cerr << e.what() << '\n';  // 포인트 매칭 레이어 로딩 실패 시 오류 메시지 출력
+
+    // 이미 캐시에 있는 라벨은 건너뜀
+    std::vector<std::string> new_labels;
+    std::vector<int64_t> rows;
+    for (int64_t i = 0; i < cached_labels.size(); i++) {
+        if (label_embedding_index.count(cached_labels[i])) continue;
+        new_labels.push_back(cached_labels[i]);
+        rows.push_back(i);
     }
+    if (new_labels.empty()) return true;
+    torch::Tensor rows_tensor = torch::from_blob(rows.data(), {(int64_t)rows.size()}, torch::kInt64).clone();
+    append_label_embeddings(new_labels,
+                            cached_embeddings.index_select(0, rows_tensor).to(torch::kFloat32).to(device_string));
+    std::cout << "Preload " << new_labels.size() << " label embeddings from " << features_file << "\n";
+    return true;
+}
 
-    // BertBow 로드
-    bert_bow_ptr = std::make_shared<BertBow>(weight_folder + "/bert_bow.txt",
-                                             weight_folder + "/bert_bow.pt", true);
-    enable_bert_bow = bert_bow_ptr->is_loaded();  // BertBow 로드 여부 확인
-    std::cout << "Enable bert bow: " << enable_bert_bow << "\n";
+bool SgNet::save_label_embeddings(const std::string &labels_file, const std::string &features_file) const
+{
+    if (label_embedding_number == 0) {
+        open3d::utility::LogWarning("No label embeddings to save");
+        return false;
+    }
 
-    // 토크나이저 로드 및 초기화
-    tokenizer.reset(radish::TextTokenizerFactory::Create("radish::BertTokenizer"));  // BERT 토크나이저 생성
-    tokenizer->Init(vocab_path);  // 어휘 파일로 초기화
-    std::cout << "Tokenizer loaded and initialized\n";
+    // BertBow와 같은 형식: "index.label" 텍스트와 pickle 텐서
+    std::vector<const std::string *> names(label_embedding_number, nullptr);
+    for (const auto &label_index : label_embedding_index) names[label_index.second] = &label_index.first;
+    std::ofstream label_out(labels_file, std::ofstream::out);
+    if (!label_out.is_open()) {
+        std::cerr << "Error: cannot open file " << labels_file << std::endl;
+        return false;
+    }
+    for (int64_t i = 0; i < label_embedding_number; i++) label_out << i << "." << *names[i] << "\n";
+    label_out.close();
+
+    torch::Tensor cpu_embeddings = label_embeddings.narrow(0, 0, label_embedding_number).to(torch::kCPU).clone();
+    std::vector<char> bytes = torch::pickle_save(cpu_embeddings);
+    std::ofstream feature_out(features_file, std::ios::binary);
+    if (!feature_out.is_open()) {
+        std::cerr << "Error: cannot open file " << features_file << std::endl;
+        return false;
+    }
+    feature_out.write(bytes.data(), bytes.size());
+    feature_out.close();
+    std::cout << "Save " << label_embedding_number << " label embeddings to " << features_file << "\n";
+    return true;
+}
 
-    // 워밍업 반복 횟수 설정
-    if (config.warm_up_iter > 0) warm_up(config.warm_up_iter, true);  // 워밍업 수행
+bool SgNet::save_label_embeddings() const
+{
+    if (config.label_embedding_cache.empty()) return false;
+    return save_label_embeddings(config.label_embedding_cache + ".txt", config.label_embedding_cache + ".pt");
 }
 
 bool SgNet::load_bert(const std::string weight_folder)
 {
+    if (bert_encoder.is_loaded()) return true;  // 이미 로드된 모듈은 재사용
     std::string bert_path = weight_folder + "/bert_script.pt";  // BERT 모델 경로 설정
     o3d_utility::Timer timer;  // 타이머 객체 생성
     timer.Start();  // 타이머 시작
 
-    try
-    {
-        bert_encoder = torch::jit::load(bert_path);  // BERT 모델 로드
-        bert_encoder.to(cuda_device_string);  // CUDA 장치로 모델 이동
-        std::cout << "Load bert from " << bert_path << std::endl;  // 모델 로드 완료 메시지 출력
-    }
-    catch(const std::exception& e)  // 예외 처리
-    {
-        std::cerr << e.what() << '\n';  // 오류 메시지 출력
-        return false;  // 로딩 실패 시 false 반환
-    }
+    if (!bert_encoder.load(bert_path, device_string)) return false;  // BERT 모델 로드
     timer.Stop();  // 타이머 종료
     std::cout << "Load bert time cost (ms): " << timer.GetDurationInMillisecond() << "\n";  // 로딩 시간 출력
 
@@ -172,24 +328,25 @@ bool SgNet::load_bert(const std::string weight_folder)
 
 void SgNet::warm_up(int inter, bool verbose)
 {
+    c10::InferenceMode guard;  // 추론 모드 (autograd 기록 없음)
     // 더미 텐서 데이터를 생성
     int N = 120;  // 노드 개수
     const int semantic_dim = 768;  // 의미적 임베딩 차원
 
     // triplet_verify_mask 텐서 생성 (모든 값은 0)
-    triplet_verify_mask = torch::zeros({N, config.triplet_number, 3}).to(torch::kInt8).to(cuda_device_string);
+    triplet_verify_mask = torch::zeros({N, config.triplet_number, 3}).to(torch::kInt8).to(device_string);
 
     // 의미적 임베딩, 박스, 중심점, 앵커 등을 무작위로 생성
-    semantic_embeddings = torch::rand({N, semantic_dim}).to(cuda_device_string);  // 의미적 임베딩
-    boxes = torch::rand({N, 3}).to(cuda_device_string);  // 박스 크기
-    centroids = torch::rand({N, 3}).to(cuda_device_string);  // 중심점
+    semantic_embeddings = torch::rand({N, semantic_dim}).to(device_string);  // 의미적 임베딩
+    boxes = torch::rand({N, 3}).to(device_string);  // 박스 크기
+    centroids = torch::rand({N, 3}).to(device_string);  // 중심점
 
     // 앵커는 0, 1, 2, ..., N-1로 설정
-    anchors = torch::arange(N).to(torch::kInt32).to(cuda_device_string);
+    anchors = torch::arange(N).to(torch::kInt32).to(device_string);
     
     // 삼중항 코너 값은 0부터 N-1까지의 랜덤 값으로 생성
-    corners = torch::randint(0, N, {N, config.triplet_number, 2}).to(torch::kInt32).to(cuda_device_string);
-    corners_mask = torch::ones({N, config.triplet_number}).to(torch::kInt32).to(cuda_device_string);  // 모든 값은 1로 초기화
+    corners = torch::randint(0, N, {N, config.triplet_number, 2}).to(torch::kInt32).to(device_string);
+    corners_mask = torch::ones({N, config.triplet_number}).to(torch::kInt32).to(device_string);  // 모든 값은 1로 초기화
 
     // 모델 실행
     if(verbose) std::cout << "Warm up SGNet with " << inter << " iterations\n";  // 워밍업 반복 횟수 출력
@@ -198,95 +355,49 @@ void SgNet::warm_up(int inter, bool verbose)
         auto output = sgnet_lt.forward({semantic_embeddings, boxes, centroids, anchors, corners, corners_mask}).toTuple();
     }
 
+    sgnet_lt.reset_latency();  // 워밍업 호출은 지연 시간 통계에서 제외
+
     // 워밍업 완료 메시지 출력
     if(verbose) std::cout << "Warm up SGNet done\n";
 }
 
-bool SgNet::graph_encoder(const std::vector<NodePtr> &nodes, torch::Tensor &node_features)
+bool SgNet::graph_encoder(const Graph &graph, torch::Tensor &node_features)
 {
+    wait_warm_up();  // 백그라운드 워밍업이 끝날 때까지 대기
+    c10::InferenceMode guard;  // 추론 모드 (autograd 기록 없음)
+    const std::vector<NodePtr> &nodes = graph.get_const_nodes();  // 노드 목록
     int N = nodes.size();  // 노드 개수
 
-    // 각 노드의 중심점, 박스 크기, 라벨 등을 저장할 배열 선언
-    float centroids_arr[N][3];
-    float boxes_arr[N][3];
-    std::vector<std::string> labels;  // 노드의 의미적 라벨을 저장할 벡터
-    float tokens[N][config.token_padding] = {};  // 토큰화된 라벨을 저장할 배열
-    float tokens_attention_mask[N][config.token_padding] = {};  // 토큰의 어텐션 마스크를 저장할 배열
-    std::vector<int> triplet_anchors;  // 유효한 삼중항의 인덱스를 저장할 벡터
-    std::vector<std::vector<Corner>> triplet_corners;  // 삼중항 코너를 저장할 벡터
+    // 노드의 의미적 라벨을 저장할 배열 선언
+    std::vector<std::string> labels;  // 노드의 의미적 라벨 (온라인 BERT에서만 사용)
+    std::vector<LabelId> label_ids;  // 노드의 전역 라벨 ID (BertBow에서 사용)
+    std::vector<int32_t> triplet_anchors, triplet_corners, triplet_corners_masks;  // 삼중항 연속 배열
     float timer_array[5];  // 타이머를 측정할 배열
     open3d::utility::Timer timer;  // 타이머 객체
 
-    labels.reserve(N);  // 라벨 벡터의 용량을 노드 수만큼 예약
-
-    // 노드 정보를 추출
+    // 노드 라벨 추출
     timer.Start();
-    for (int i = 0; i < N; i++) {
-        const NodePtr node = nodes[i];  // 노드 포인터 참조
-        Eigen::Vector3d centroid = node->centroid;  // 노드의 중심점
-        Eigen::Vector3d extent = node->bbox_shape;  // 노드의 박스 크기
-
-        // 중심점과 박스 크기를 배열에 저장
-        centroids_arr[i][0] = centroid[0];
-        centroids_arr[i][1] = centroid[1];
-        centroids_arr[i][2] = centroid[2];
-
-        boxes_arr[i][0] = extent[0];
-        boxes_arr[i][1] = extent[1];
-        boxes_arr[i][2] = extent[2];
-
-        // 라벨을 BERT-BOW로 처리
-        if (enable_bert_bow) {
-            labels.emplace_back(node->semantic);  // BERT-BOW 사용 시 라벨 추가
-        } else {
-            // BERT를 사용하여 라벨을 토큰화하고, 어텐션 마스크를 설정
-            std::vector<int> label_tokens = tokenizer->Encode(node->semantic);  // 라벨을 토큰화
-            tokens[i][0] = 101;  // 시작 토큰
-            int k = 1;
-            for (auto token : label_tokens) {
-                tokens[i][k] = token;  // 토큰 저장
-                k++;
-            }
-            tokens[i][k] = 102;  // 종료 토큰
-
-            // 어텐션 마스크 설정
-            for (int iter = 0; iter <= k; iter++) {
-                tokens_attention_mask[i][iter] = 1;
-            }
-        }
-
-        // 삼중항 코너 샘플링
-        if (node->corners.size() > 0) {
-            triplet_anchors.push_back(i);  // 유효한 삼중항 추가
-            std::vector<Corner> corner_vector;
-            node->sample_corners(config.triplet_number, corner_vector, N);  // 코너 샘플링
-            triplet_corners.push_back(corner_vector);  // 코너 정보 저장
-        }
+    if (enable_bert_bow) {
+        label_ids.reserve(N);  // 문자열 복사와 해시 없이 라벨 ID만 모음
+        for (const NodePtr &node : nodes) label_ids.push_back(node->get_semantic_id());
+    } else {
+        labels.reserve(N);  // 라벨 벡터의 용량을 노드 수만큼 예약
+        for (const NodePtr &node : nodes) labels.emplace_back(node->get_semantic());
     }
+
+    // 삼중항 코너 샘플링. 그래프가 연속 배열에 바로 기록
+    int N_valid = graph.sample_triplets(config.triplet_number,
+                                        triplet_anchors, triplet_corners, triplet_corners_masks);
     timer.Stop();
     timer_array[0] = timer.GetDurationInMillisecond();  // 타이머 측정 완료
 
-    // 삼중항 처리
+    // 입력 텐서 생성. 그래프의 연속 배열을 그대로 감싸서 장치로 복사
     timer.Start();
-    int N_valid = triplet_anchors.size();  // 유효한 삼중항 노드 수
-    float triplet_anchors_arr[N_valid];
-    float triplet_corners_arr[N_valid][config.triplet_number][2];
-    float triplet_corners_masks[N_valid][config.triplet_number] = {};  // 마스크 초기화
-    for (int i = 0; i < N_valid; i++) {
-        triplet_anchors_arr[i] = triplet_anchors[i];
-        for (int j = 0; j < config.triplet_number; j++) {
-            triplet_corners_arr[i][j][0] = triplet_corners[i][j][0];
-            triplet_corners_arr[i][j][1] = triplet_corners[i][j][1];
-            if (triplet_corners[i][j][0] < N) triplet_corners_masks[i][j] = 1;  // 유효한 삼중항에 대해서만 마스크 설정
-        }
-    }
-
-    // 입력 텐서 생성
-    boxes = torch::from_blob(boxes_arr, {N, 3}).to(cuda_device_string);  // 박스 텐서 생성
-    centroids = torch::from_blob(centroids_arr, {N, 3}).to(cuda_device_string);  // 중심점 텐서 생성
-    anchors = torch::from_blob(triplet_anchors_arr, {N_valid}).to(torch::kInt32).to(cuda_device_string);  // 앵커 텐서 생성
-    corners = torch::from_blob(triplet_corners_arr, {N_valid, config.triplet_number, 2}).to(torch::kInt32).to(cuda_device_string);  // 코너 텐서 생성
-    corners_mask = torch::from_blob(triplet_corners_masks, {N_valid, config.triplet_number}).to(torch::kInt32).to(cuda_device_string);  // 코너 마스크 텐서 생성
+    boxes = torch::from_blob(const_cast<float *>(graph.get_box_data()), {N, 3}, torch::kFloat32).to(device_string);  // 박스 텐서 생성
+    centroids = torch::from_blob(const_cast<float *>(graph.get_centroid_data()), {N, 3}, torch::kFloat32).to(device_string);  // 중심점 텐서 생성
+    anchors = torch::from_blob(triplet_anchors.data(), {N_valid}, torch::kInt32).to(device_string);  // 앵커 텐서 생성
+    corners = torch::from_blob(triplet_corners.data(), {N_valid, config.triplet_number, 2}, torch::kInt32).to(device_string);  // 코너 텐서 생성
+    corners_mask = torch::from_blob(triplet_corners_masks.data(), {N_valid, config.triplet_number}, torch::kInt32).to(device_string);  // 코너 마스크 텐서 생성
 
     timer.Stop();
     timer_array[1] = timer.GetDurationInMillisecond();  // 타이머 측정 완료
@@ -294,19 +405,22 @@ bool SgNet::graph_encoder(const std::vector<NodePtr> &nodes, torch::Tensor &node
     // BERT-BOW 또는 BERT를 사용하여 의미적 임베딩 생성
     timer.Start();
     if (enable_bert_bow) {
-        bool bert_bow_ret = bert_bow_ptr->query_semantic_features(labels, semantic_embeddings);  // BertBow를 사용하여 임베딩 쿼리
-        semantic_embeddings = semantic_embeddings.to(cuda_device_string);  // CUDA 장치로 이동
+        bool bert_bow_ret = bert_bow_ptr->query_semantic_features(label_ids, semantic_embeddings);  // BertBow를 사용하여 임베딩 쿼리
+        semantic_embeddings = semantic_embeddings.to(device_string);  // 추론 장치로 이동
     } else {
-        // BERT로 의미적 임베딩 생성
-        torch::Tensor input_ids = torch::from_blob(tokens, {N, config.token_padding}).to(torch::kInt32).to(cuda_device_string);  // 입력 ID 텐서
-        torch::Tensor attention_mask = torch::from_blob(tokens_attention_mask, {N, config.token_padding}).to(torch::kInt32).to(cuda_device_string);  // 어텐션 마스크 텐서
-        torch::Tensor token_type_ids = torch::zeros({N, config.token_padding}).to(torch::kInt32).to(cuda_device_string);  // 토큰 타입 ID 텐서
-
-        semantic_embeddings = bert_encoder.forward({input_ids, attention_mask, token_type_ids}).toTensor();  // BERT 인코더 실행
-
-        int semantic_nan = check_nan_features(semantic_embeddings);  // NaN 체크
-        if (semantic_nan > 0)
-            open3d::utility::LogWarning("Found {:d} nan semantic embeddings", semantic_nan);  // NaN이 있는 경우 경고
+        // 캐시에 없는 라벨만 BERT로 인코딩한 뒤, 캐시에서 노드별 임베딩을 모음
+        if (!update_label_embeddings(labels)) return false;
+        std::vector<int64_t> embedding_indices;
+        embedding_indices.reserve(N);
+        for (const std::string &label : labels) embedding_indices.push_back(label_embedding_index.at(label));
+        torch::Tensor indices = torch::from_blob(embedding_indices.data(), {N}, torch::kInt64).to(device_string);
+        semantic_embeddings = torch::index_select(label_embeddings, 0, indices);
+
+        if (config.validation_level > 0) {
+            int semantic_nan = check_nan_features(semantic_embeddings);  // NaN 체크
+            if (semantic_nan > 0)
+                open3d::utility::LogWarning("Found {:d} nan semantic embeddings", semantic_nan);  // NaN이 있는 경우 경고
+        }
     }
     std::cout << "Bert output correct\n";  // BERT 출력 정상 확인
     timer.Stop();
@@ -314,7 +428,7 @@ bool SgNet::graph_encoder(const std::vector<NodePtr> &nodes, torch::Tensor &node
 
     // 그래프 인코딩
     timer.Start();
-    assert(semantic_embeddings.device().str() == cuda_device_string);  // 장치 확인
+    assert(semantic_embeddings.device().str() == device_string);  // 장치 확인
 
     // SGNet 모델 실행
     auto output = sgnet_lt.forward({semantic_embeddings, boxes, centroids, anchors, corners, corners_mask}).toTuple();
@@ -326,13 +440,7 @@ bool SgNet::graph_encoder(const std::vector<NodePtr> &nodes, torch::Tensor &node
 
     // NaN 체크
     timer.Start();
-    int node_nan = check_nan_features(node_features);  // 노드 특징의 NaN 체크
-    if (node_nan > 0) {
-        open3d::utility::LogWarning("Found {:d} nan node features", node_nan);  // NaN이 있는 경우 경고
-        auto nan_mask = torch::isnan(node_features);  // NaN 마스크 생성
-        node_features.index_put_({nan_mask.to(torch::kBool)}, 0);  // NaN 값을 0으로 설정
-        open3d::utility::LogWarning("Set nan node features to 0");  // NaN을 0으로 설정
-    }
+    node_features = validate_features(node_features, "node features");  // NaN 값을 장치에서 0으로 설정
     timer.Stop();
     timer_array[4] = timer.GetDurationInMillisecond();  // 타이머 측정 완료
 
@@ -350,6 +458,7 @@ bool SgNet::graph_encoder(const std::vector<NodePtr> &nodes, torch::Tensor &node
 void SgNet::match_nodes(const torch::Tensor &src_node_features, const torch::Tensor &ref_node_features,
                             std::vector<std::pair<uint32_t, uint32_t>> &match_pairs, std::vector<float> &match_scores, bool fused)
 {
+    c10::InferenceMode guard;  // 추론 모드 (autograd 기록 없음)
     // 매칭 레이어
     int Ns = src_node_features.size(0);  // 원본 노드 수
     int Nr = ref_node_features.size(0);  // 참조 노드 수
@@ -358,10 +467,7 @@ void SgNet::match_nodes(const torch::Tensor &src_node_features, const torch::Ten
     std::cout << "Matching " << Ns << " src nodes and " << Nr << " ref nodes in fused mode:" << fused << "\n";  // 매칭 상태 출력
     assert(Ds == Dr);  // 원본과 참조 노드의 특징 차원 수가 동일한지 확인
 
-    // NaN 값 체크
-    int src_nan_sum = torch::isnan(src_node_features).sum().item<int>();  // 원본 노드 특징에서 NaN 값의 개수
-    int ref_nan_sum = torch::isnan(ref_node_features).sum().item<int>();  // 참조 노드 특징에서 NaN 값의 개수
-    assert(src_nan_sum == 0 && ref_nan_sum == 0);  // NaN 값이 없는지 확인
+    validate_match_inputs(src_node_features, ref_node_features);  // NaN 값 체크 (검증 수준이 0이면 생략)
 
     c10::intrusive_ptr<torch::ivalue::Tuple> match_output;  // 매칭 결과 저장 변수
 
@@ -396,29 +502,91 @@ void SgNet::match_nodes(const torch::Tensor &src_node_features, const torch::Ten
         }
     }
 
-    // Kn 행렬에서 NaN 값이 있는지 확인
-    auto check_col = torch::sum(torch::isnan(Kn), 0);  // 각 열에서 NaN 값의 개수 체크
-    for (int j = 0; j < check_col.size(0); j++) {
-        if (check_col[j].item<int>() > 0) {  // NaN이 있는 열에 대해 경고 출력
-            open3d::utility::LogWarning("Ref node {:d} nan in Kn matrix", j);
-        }
+    validate_match_output(Kn);  // Kn 행렬의 NaN 열 체크 (검증 수준이 0이면 생략)
+}
+
+void SgNet::validate_match_inputs(const torch::Tensor &src_node_features, const torch::Tensor &ref_node_features) const
+{
+    if (config.validation_level < 1) return;  // 수준 0은 호스트 동기화 없음
+    int src_nan = check_nan_features(src_node_features);  // 원본 노드 특징에서 NaN 노드 수
+    int ref_nan = check_nan_features(ref_node_features);  // 참조 노드 특징에서 NaN 노드 수
+    if (src_nan > 0 || ref_nan > 0)
+        open3d::utility::LogWarning("Found {:d} src and {:d} ref nan nodes before matching", src_nan, ref_nan);
+    if (config.validation_level > 1) assert(src_nan == 0 && ref_nan == 0);  // NaN 값이 없는지 확인
+}
+
+void SgNet::validate_match_output(const torch::Tensor &Kn) const
+{
+    if (config.validation_level < 1) return;
+    // Kn 행렬에서 NaN 값이 있는 열을 한 번에 찾아 CPU로 복사 (열마다 동기화하지 않음)
+    torch::Tensor nan_cols = torch::isnan(Kn).any(0).nonzero().view(-1).to(torch::kCPU);
+    if (nan_cols.size(0) > 0) {
+        std::stringstream msg;
+        auto nan_cols_a = nan_cols.accessor<int64_t, 1>();
+        for (int j = 0; j < nan_cols.size(0); j++) msg << nan_cols_a[j] << ",";
+        open3d::utility::LogWarning("Found nan in Kn matrix at ref nodes {}", msg.str());
+    }
+}
+
+void SgNet::match_nodes_batch(const std::vector<torch::Tensor> &src_node_features_list,
+                              const std::vector<torch::Tensor> &ref_node_features_list,
+                              const std::vector<bool> &fused_list,
+                              std::vector<std::vector<std::pair<uint32_t, uint32_t>>> &match_pairs_list,
+                              std::vector<std::vector<float>> &match_scores_list)
+{
+    c10::InferenceMode guard;  // 추론 모드 (autograd 기록 없음)
+    int K = ref_node_features_list.size();  // 참조 그래프 수
+    assert(src_node_features_list.size() == K && fused_list.size() == K);
+    match_pairs_list.assign(K, {});
+    match_scores_list.assign(K, {});
+    if (K == 0) return;
+
+    // 매칭 레이어를 모두 실행. 결과는 장치에 남겨 두고 호스트 동기화는 마지막에 한 번만 수행
+    std::vector<torch::Tensor> matches_list, scores_list;
+    std::vector<int64_t> counts(K);
+    matches_list.reserve(K);
+    scores_list.reserve(K);
+    for (int k = 0; k < K; k++) {
+        validate_match_inputs(src_node_features_list[k], ref_node_features_list[k]);  // 검증 수준이 0이면 생략
+        InferenceModule &match_layer = fused_list[k] ? fused_match_layer : light_match_layer;
+        auto match_output = match_layer.forward({src_node_features_list[k], ref_node_features_list[k]}).toTuple();
+        validate_match_output(match_output->elements()[2].toTensor());  // Kn 행렬 체크
+        torch::Tensor matches = match_output->elements()[0].toTensor().to(torch::kInt64);  // 매칭된 쌍 (M_k, 2)
+        torch::Tensor matches_scores = match_output->elements()[1].toTensor().to(torch::kFloat32);  // 매칭 점수 (M_k,)
+        counts[k] = matches.size(0);
+        matches_list.push_back(matches.view({-1, 2}));
+        scores_list.push_back(matches_scores.view({-1}));
     }
 
-    int check = torch::sum(torch::isnan(Kn)).item<int>();  // Kn 행렬에서 NaN 값의 총 개수 체크
-    if (check > 0) {  // NaN 값이 존재하면 경고 출력
-        open3d::utility::LogWarning("Found {:d} nan in Kn matrix", check);
+    // 한 번의 복사로 모든 결과를 CPU로 이동
+    torch::Tensor matches = torch::cat(matches_list, 0).to(torch::kCPU);
+    torch::Tensor matches_scores = torch::cat(scores_list, 0).to(torch::kCPU);
+    auto matches_a = matches.accessor<int64_t, 2>();
+    auto matches_scores_a = matches_scores.accessor<float, 1>();
+
+    // 참조 그래프별로 임계값을 넘는 매칭만 저장
+    int64_t offset = 0;
+    for (int k = 0; k < K; k++) {
+        for (int64_t i = offset; i < offset + counts[k]; i++) {
+            float score = matches_scores_a[i];
+            if (score > config.instance_match_threshold) {
+                match_pairs_list[k].emplace_back(matches_a[i][0], matches_a[i][1]);
+                match_scores_list[k].push_back(score);
+            }
+        }
+        offset += counts[k];
     }
+    std::cout << "Matched " << K << " ref graphs in one batch, " << offset << " candidate pairs\n";
 }
 
 int SgNet::match_points(const torch::Tensor &src_guided_knn_feats, 
                         const torch::Tensor &ref_guided_knn_feats,
                         const torch::Tensor &src_guided_knn_points,
                         const torch::Tensor &ref_guided_knn_points,
-                        std::vector<Eigen::Vector3d> &corr_src_points,
-                        std::vector<Eigen::Vector3d> &corr_ref_points,
-                        std::vector<int> &corr_match_indices,
-                        std::vector<float> &corr_scores_vec)
+                        CorrespondenceBuffer &corr,
+                        int match_offset)
 {
+    c10::InferenceMode guard;  // 추론 모드 (autograd 기록 없음)
     std::stringstream msg;  // 메시지 스트림
     open3d::utility::Timer timer;  // 타이머 객체 생성
     timer.Start();  // 타이머 시작
@@ -431,63 +599,72 @@ int SgNet::match_points(const torch::Tensor &src_guided_knn_feats,
     timer.Stop();  // 타이머 종료
     msg << "match " << timer.GetDurationInMillisecond() << " ms, ";
 
-    int M = src_guided_knn_feats.size(0);  // 원본 노드 수
     int C = corr_points.size(0);  // 일치하는 포인트 수
     std::cout << "Find " << C << " matched points\n";  // 매칭된 포인트 수 출력
 
     if (C > 0) {
-        // 일치하는 포인트 인덱싱
+        timer.Start();
         using namespace torch::indexing;
-        torch::Tensor corr_match_indices_t = corr_points.index({"...", 0}).to(torch::kInt32);  // (C,)
-        torch::Tensor corr_src_indices = corr_points.index({"...", 1}).to(torch::kInt32);  // (C)
-        torch::Tensor corr_ref_indices = corr_points.index({"...", 2}).to(torch::kInt32);  // (C)
-        
-        assert(corr_match_indices_t.max() < src_guided_knn_points.size(0));  // 원본 포인트 크기 확인
-        assert(corr_src_indices.max() < src_guided_knn_points.size(1));  // 원본 포인트 크기 확인
-        assert(corr_ref_indices.max() < ref_guided_knn_points.size(1));  // 참조 포인트 크기 확인
-
-        // 일치하는 포인트 좌표 추출
-        torch::Tensor corr_src_points_t = src_guided_knn_points.index({corr_match_indices_t, corr_src_indices}).to(torch::kFloat32);  // (C,3)
-        torch::Tensor corr_ref_points_t = ref_guided_knn_points.index({corr_match_indices_t, corr_ref_indices}).to(torch::kFloat32);  // (C,3)
-
-        // CPU로 이동하여 메모리에서 처리
-        torch::Tensor corr_points_cpu = corr_points.clone().to(torch::kCPU);
-        matching_scores = matching_scores.to(torch::kCPU);
-        corr_src_points_t = corr_src_points_t.to(torch::kCPU);
-        corr_ref_points_t = corr_ref_points_t.to(torch::kCPU);
-
-        // 텐서 어세서 생성
-        auto corr_src_points_a = corr_src_points_t.accessor<float, 2>();
-        auto corr_ref_points_a = corr_ref_points_t.accessor<float, 2>();        
-        auto corr_points_a = corr_points_cpu.accessor<long, 2>();
-        auto matching_scores_a = matching_scores.accessor<float, 3>();
-
-        corr_match_indices = std::vector<int>(C, -1);  // 매칭된 포인트 인덱스를 저장할 벡터
-        corr_scores_vec = std::vector<float>(C, 0.0);  // 매칭된 포인트의 점수를 저장할 벡터
-
-        int min_match_index = 100;
-        float min_score = 1.0;
-        // 일치하는 포인트와 점수 추출
-        for (int i = 0; i < C; i++) {
-            int match_index = corr_points_a[i][0];
-            int src_index = corr_points_a[i][1];
-            int ref_index = corr_points_a[i][2];
-            corr_match_indices[i] = match_index;
-            corr_scores_vec[i] = matching_scores_a[match_index][src_index][ref_index];  // 점수 저장
-
-            // 일치하는 포인트 좌표 저장
-            corr_src_points.push_back({corr_src_points_a[i][0], corr_src_points_a[i][1], corr_src_points_a[i][2]});
-            corr_ref_points.push_back({corr_ref_points_a[i][0], corr_ref_points_a[i][1], corr_ref_points_a[i][2]});
-            assert(match_index >= 0 && match_index < M);
-        }
+        torch::Tensor corr_match_indices_t = corr_points.index({"...", 0});  // (C,)
+        torch::Tensor corr_src_indices = corr_points.index({"...", 1});  // (C)
+        torch::Tensor corr_ref_indices = corr_points.index({"...", 2});  // (C)
+        assert(corr_match_indices_t.max().item<int64_t>() < src_guided_knn_points.size(0));  // 원본 포인트 크기 확인
+
+        // 좌표와 점수를 장치에서 모은 뒤 출력 버퍼로 바로 복사. (M,K,K) 점수 전체는 호스트로 옮기지 않음
+        int offset = corr.extend(C);
+        copy_points_to_matrix(src_guided_knn_points.index({corr_match_indices_t, corr_src_indices}), corr.src_points, offset);
+        copy_points_to_matrix(ref_guided_knn_points.index({corr_match_indices_t, corr_ref_indices}), corr.ref_points, offset);
+        torch::from_blob(corr.scores.data() + offset, {C}, torch::kFloat32)
+            .copy_(matching_scores.index({corr_match_indices_t, corr_src_indices, corr_ref_indices}).to(torch::kFloat32));
+        torch::from_blob(corr.match_indices.data() + offset, {C}, torch::kInt32)
+            .copy_((corr_match_indices_t + match_offset).to(torch::kInt32));
+
+        timer.Stop();
+        msg << "extract " << timer.GetDurationInMillisecond() << " ms";
         std::cout << msg.str() << "\n";  // 메시지 출력
     }
 
     return C;  // 일치하는 포인트 수 반환
 }
 
+int SgNet::match_points(const torch::Tensor &src_guided_knn_feats, 
+                        const torch::Tensor &ref_guided_knn_feats,
+                        const torch::Tensor &src_guided_knn_points,
+                        const torch::Tensor &ref_guided_knn_points,
+                        std::vector<Eigen::Vector3d> &corr_src_points,
+                        std::vector<Eigen::Vector3d> &corr_ref_points,
+                        std::vector<int> &corr_match_indices,
+                        std::vector<float> &corr_scores_vec,
+                        int match_offset)
+{
+    CorrespondenceBuffer corr;
+    int C = match_points(src_guided_knn_feats, ref_guided_knn_feats,
+                         src_guided_knn_points, ref_guided_knn_points, corr, match_offset);
+    corr.append_to(corr_src_points, corr_ref_points, corr_match_indices, corr_scores_vec);
+    return C;
+}
+
+torch::Tensor SgNet::validate_features(const torch::Tensor &features, const std::string &name) const
+{
+    if (config.validation_level > 0) {
+        int nan_nodes = check_nan_features(features);  // 텐서당 한 번의 동기화
+        if (nan_nodes > 0) open3d::utility::LogWarning("Found {:d} nan {}. Set them to 0", nan_nodes, name);
+        if (config.validation_level > 1) assert(nan_nodes == 0);
+    }
+    return sanitize_nan_features(features);
+}
+
+std::string SgNet::print_latency() const
+{
+    std::stringstream msg;
+    for (const InferenceModule *module : {&bert_encoder, &sgnet_lt, &light_match_layer, &fused_match_layer, &point_match_layer})
+        msg << " - " << module->print_latency() << "\n";
+    return msg.str();
+}
+
 bool SgNet::save_hidden_features(const std::string &dir)
 {
+    wait_warm_up();  // 워밍업이 숨겨진 상태 변수를 덮어쓰지 않도록 대기
     if (semantic_embeddings.size(0) == 0) {  // 임베딩이 없다면 경고 메시지 출력
         open3d::utility::LogWarning("No hidden features to save");
         return false;  // 실패 시 false 반환
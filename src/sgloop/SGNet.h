@@ -3,13 +3,17 @@
 
 #include <torch/script.h>  // PyTorch 스크립트 API 관련 라이브러리
 #include <torch/torch.h>   // PyTorch 텐서 관련 라이브러리
+#include <torch/csrc/jit/codegen/onednn/interface.h>  // oneDNN 그래프 융합 설정
 #include <array>           // 배열 관련 라이브러리
+#include <future>          // 병렬 모델 로드와 백그라운드 워밍업
 #include <iostream>        // 표준 입출력 관련 라이브러리
 #include <memory>          // 스마트 포인터 관련 라이브러리
 
 #include <mapping/Instance.h>  // 인스턴스 헤더 파일
 #include <sgloop/Graph.h>      // Graph 헤더 파일
 #include <sgloop/BertBow.h>    // BertBow 헤더 파일
+#include <sgloop/InferenceSession.h>  // 추론 세션 헤더 파일
+#include <tools/CorrespondenceBuffer.h>  // 포인트 대응 버퍼 헤더 파일
 #include <tokenizer/text_tokenizer.h>  // 텍스트 토크나이저 헤더 파일
 #include <Common.h>  // 공통 헤더 파일
 
@@ -23,42 +27,70 @@ int extract_corr_points(const torch::Tensor &src_guided_knn_points,
                         std::vector<Eigen::Vector3d> &corr_src_points, 
                         std::vector<Eigen::Vector3d> &corr_ref_points);
 
+/// @brief  설정에 따라 추론 장치를 선택하고 CPU 스레드 수와 oneDNN 융합을 적용
+/// @return "cuda:N" 또는 "cpu"
+std::string configure_torch_backend(const SgNetConfig &config, int cuda_number);
+
 // NaN 특징의 개수를 체크하는 함수
 /// @brief  
 /// @param features, (N, D) 
 /// @return number_nan_features
 int check_nan_features(const torch::Tensor &features);
 
+/// @brief  NaN 값을 장치에서 0으로 바꾸는 함수 (호스트 동기화 없음)
+torch::Tensor sanitize_nan_features(const torch::Tensor &features);
+
 class SgNet
 {
 
 public:
-    // 생성자: SgNetConfig와 weight 폴더, CUDA 장치 번호를 입력받음
+    // 생성자: SgNetConfig와 weight 폴더, CUDA 장치 번호를 입력받음.
+    // 모듈은 병렬로 로드되고, 워밍업은 백그라운드에서 실행됨
     SgNet(const SgNetConfig &config_, const std::string weight_folder, int cuda_number_=0);
     
-    // 소멸자
-    ~SgNet() {};
+    // 소멸자: 백그라운드 워밍업이 끝날 때까지 대기
+    ~SgNet();
+
+    // 백그라운드 워밍업이 끝날 때까지 대기하는 함수 (워밍업이 없거나 끝났으면 바로 반환)
+    void wait_warm_up() const;
 
     /// \brief 모달리티 인코더와 그래프 인코더 함수
-    /// \param nodes 
+    /// \param graph 간선과 삼중항이 구성된 그래프
     /// \param node_features 
     /// \return  
-    bool graph_encoder(const std::vector<NodePtr> &nodes, torch::Tensor &node_features);
+    bool graph_encoder(const Graph &graph, torch::Tensor &node_features);
 
     // 노드들 간 매칭 함수
     void match_nodes(const torch::Tensor &src_node_features, const torch::Tensor &ref_node_features,
         std::vector<std::pair<uint32_t,uint32_t>> &match_pairs, std::vector<float> &match_scores, bool fused=false);
 
+    /// \brief  여러 참조 그래프에 대한 노드 매칭. 모든 매칭 레이어를 먼저 실행하고
+    ///         결과를 한 번에 호스트로 복사하여 참조 그래프마다 동기화하지 않음
+    /// \param src_node_features_list  참조 그래프별 원본 노드 특징 (융합 여부에 따라 다를 수 있음)
+    /// \param ref_node_features_list  참조 그래프별 노드 특징
+    /// \param fused_list              참조 그래프별 융합 매칭 레이어 사용 여부
+    void match_nodes_batch(const std::vector<torch::Tensor> &src_node_features_list,
+                           const std::vector<torch::Tensor> &ref_node_features_list,
+                           const std::vector<bool> &fused_list,
+                           std::vector<std::vector<std::pair<uint32_t,uint32_t>>> &match_pairs_list,
+                           std::vector<std::vector<float>> &match_scores_list);
+
     /// \brief  일치하는 노드들의 포인트 매칭 함수. 각 노드는 512개의 포인트를 샘플링.
     /// \param src_guided_knn_feats (M,512,256)
     /// \param ref_guided_knn_feats (M,512,256)
     /// \param src_guided_knn_points (M,512,3)
     /// \param ref_guided_knn_points (M,512,3)
-    /// \param corr_src_points (C,3)
-    /// \param corr_ref_points (C,3)
-    /// \param corr_match_indices (C,)
-    /// \param corr_scores_vec (C,)
+    /// \param corr 대응 버퍼. 좌표 (C,3), 매칭 쌍 인덱스 (C,), 점수 (C,)가 뒤에 추가됨
+    /// \param match_offset 청크 단위로 호출할 때 매칭 쌍 인덱스에 더할 오프셋
     /// \return C, 매칭된 포인트의 개수
+    int match_points(const torch::Tensor &src_guided_knn_feats, 
+                    const torch::Tensor &ref_guided_knn_feats,
+                    const torch::Tensor &src_guided_knn_points,
+                    const torch::Tensor &ref_guided_knn_points,
+                    CorrespondenceBuffer &corr,
+                    int match_offset=0);
+
+    // 포인트 매칭 결과를 Vector3d 벡터로 받는 함수 (대응 버퍼 버전을 감쌈)
     int match_points(const torch::Tensor &src_guided_knn_feats, 
                     const torch::Tensor &ref_guided_knn_feats,
                     const torch::Tensor &src_guided_knn_points,
@@ -66,14 +98,34 @@ public:
                     std::vector<Eigen::Vector3d> &corr_src_points,
                     std::vector<Eigen::Vector3d> &corr_ref_points,
                     std::vector<int> &corr_match_indices,
-                    std::vector<float> &corr_scores_vec);
+                    std::vector<float> &corr_scores_vec,
+                    int match_offset=0);
 
-    // Bert 모델 로드 함수
+    // Bert 모델 로드 함수. 이미 로드되어 있으면 다시 로드하지 않음
     bool load_bert(const std::string weight_folder);
 
+    /// \brief BERT 라벨 임베딩 캐시를 파일에서 미리 로드. BertBow와 같은 형식 ("index.label" 텍스트와 pickle 텐서)
+    bool load_label_embeddings(const std::string &labels_file, const std::string &features_file);
+
+    // BERT 라벨 임베딩 캐시를 파일로 저장하는 함수
+    bool save_label_embeddings(const std::string &labels_file, const std::string &features_file) const;
+
+    // 설정된 경로(config.label_embedding_cache)에 라벨 임베딩 캐시를 저장하는 함수
+    bool save_label_embeddings() const;
+
     // 온라인 BERT 여부 반환 함수
     bool is_online_bert()const{return !enable_bert_bow;};
 
+    // 추론 장치 문자열 반환 함수
+    const std::string &get_device_string()const{return device_string;};
+
+    /// \brief 검증 수준에 따라 특징을 확인하고 NaN을 장치에서 0으로 바꾼 특징을 반환
+    ///        수준 0은 동기화 없이 정리만, 1은 NaN 노드 수를 한 번에 세어 경고, 2는 NaN이 있으면 중단
+    torch::Tensor validate_features(const torch::Tensor &features, const std::string &name) const;
+
+    // 모듈별 누적 지연 시간을 반환하는 함수
+    std::string print_latency()const;
+
     // 숨겨진 특징을 저장하는 함수
     bool save_hidden_features(const std::string &dir);
 
@@ -82,24 +134,45 @@ private:
     /// \param iter 반복 횟수
     void warm_up(int iter=10,bool verbose=true);
 
+    /// \brief 캐시에 없는 라벨만 BERT로 인코딩하여 캐시에 추가
+    bool update_label_embeddings(const std::vector<std::string> &labels);
+
+    /// \brief 라벨 U개를 토큰화하고 BERT로 (U, D) 임베딩을 계산
+    bool bert_encode(const std::vector<std::string> &labels, torch::Tensor &embeddings);
+
+    // 검증 수준이 1 이상이면 매칭 전 노드 특징의 NaN 수를 세어 경고 (2는 중단)
+    void validate_match_inputs(const torch::Tensor &src_node_features, const torch::Tensor &ref_node_features) const;
+
+    // 검증 수준이 1 이상이면 매칭 결과 Kn 행렬에서 NaN이 있는 열을 찾아 경고
+    void validate_match_output(const torch::Tensor &Kn) const;
+
+    // 캐시 텐서 뒤에 새 라벨 임베딩을 추가하는 함수 (용량이 부족하면 두 배로 확장)
+    void append_label_embeddings(const std::vector<std::string> &new_labels, const torch::Tensor &new_embeddings);
+
 private:
-    std::string cuda_device_string;  // CUDA 디바이스 문자열
+    std::string device_string;  // 추론 장치 문자열 ("cuda:N" 또는 "cpu")
     std::shared_ptr<radish::TextTokenizer> tokenizer;  // 텍스트 토크나이저
-    torch::jit::script::Module bert_encoder;  // BERT 인코더
-    torch::jit::script::Module sgnet_lt;  // SGNet 레이어
-    torch::jit::script::Module light_match_layer;  // 라이트 매칭 레이어
-    torch::jit::script::Module fused_match_layer;  // 융합된 매칭 레이어
-    torch::jit::script::Module point_match_layer;  // 포인트 매칭 레이어
+    InferenceModule bert_encoder{"bert"};  // BERT 인코더
+    InferenceModule sgnet_lt{"sgnet"};  // SGNet 레이어
+    InferenceModule light_match_layer{"light_match"};  // 라이트 매칭 레이어
+    InferenceModule fused_match_layer{"fused_match"};  // 융합된 매칭 레이어
+    InferenceModule point_match_layer{"point_match"};  // 포인트 매칭 레이어
 
     std::shared_ptr<BertBow> bert_bow_ptr;  // BertBow 포인터
     bool enable_bert_bow;  // BertBow 활성화 여부
 
     SgNetConfig config;  // SGNet 설정
+    std::shared_future<void> warm_up_future;  // 백그라운드 워밍업
 
 private: // 속도 향상을 위한 숨겨진 상태 변수들
     torch::Tensor semantic_embeddings;  // 의미적 임베딩
     torch::Tensor boxes, centroids, anchors, corners, corners_mask;  // 박스, 중심점, 앵커, 코너, 코너 마스크
     torch::Tensor triplet_verify_mask;  // 삼중항 검증 마스크
+    std::vector<int32_t> token_buffer, token_mask_buffer;  // (U, token_padding) 재사용 토큰 버퍼
+
+    std::unordered_map<std::string, int64_t> label_embedding_index;  // 라벨 -> 캐시 행
+    torch::Tensor label_embeddings;  // (capacity, D) 장치에 있는 라벨 임베딩 캐시
+    int64_t label_embedding_number = 0;  // 캐시된 라벨 수
 
 };
 
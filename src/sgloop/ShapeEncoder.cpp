@@ -1,3 +1,4 @@
+#include <random>
 #include "ShapeEncoder.h"
 
 namespace fmfusion
@@ -18,21 +19,29 @@ namespace fmfusion
         return neighbor_indices;
     }
 
-    ShapeEncoder::ShapeEncoder(const ShapeEncoderConfig &config_, const std::string weight_folder, int cuda_number) : 
-        config(config_)
+    uint64_t voxel_key(const float *p, const float &voxel_size, const int &batch)
+    {
+        // grid_subsampling snaps its origin to a multiple of the voxel size, so floor(p / voxel_size)
+        // gives the same voxel. 21 bits per axis, the top bit is the batch index (B <= 2).
+        const int64_t OFFSET = int64_t(1) << 20;
+        const uint64_t MASK = (uint64_t(1) << 21) - 1;
+        uint64_t ix = uint64_t(int64_t(std::floor(p[0] / voxel_size)) + OFFSET) & MASK;
+        uint64_t iy = uint64_t(int64_t(std::floor(p[1] / voxel_size)) + OFFSET) & MASK;
+        uint64_t iz = uint64_t(int64_t(std::floor(p[2] / voxel_size)) + OFFSET) & MASK;
+        return (uint64_t(batch) << 63) | (ix << 42) | (iy << 21) | iz;
+    }
+
+    ShapeEncoder::ShapeEncoder(const ShapeEncoderConfig &config_, const std::string weight_folder, const std::string &device) : 
+        device_string(device), config(config_)
     {
         // std::string shape_encoder_dir = weight_folder + "/instance_shape_encoder_v1.pt";
-        cuda_device_string = "cuda:" + std::to_string(cuda_number);
-        encoder_v2 = torch::jit::load(weight_folder + "/instance_shape_encoder_v2.pt");
-        encoder_v2.to(cuda_device_string);
-        std::cout<<"Load shape encoder v2 from "<<weight_folder
-                <<" on cuda:"<<cuda_number<<std::endl;
+        encoder_v2.load(weight_folder + "/instance_shape_encoder_v2.pt", device_string);
         assert(config.padding=="zero" || config.padding=="random");
         // std::cout<<config.print_msg();
 
     };
 
-    void ShapeEncoder::encode(const std::vector<Eigen::Vector3d> &xyz,  
+    void ShapeEncoder::encode(const std::vector<float> &xyz,  
                               const std::vector<int> &length_vec, 
                               const std::vector<uint32_t> &labels,
                               const std::vector<Eigen::Vector3d> &centroids_, 
@@ -43,90 +52,151 @@ namespace fmfusion
                               float &encoding_time,
                               std::string hidden_feat_dir)
     {
-        long X = xyz.size();        // point cloud number
-        long N = centroids_.size(); // node number
+        StackPyramid pyramid;
+        if(!precompute_pyramid(xyz, length_vec, labels, pyramid)) return;
+        encode_pyramid(pyramid, nodes, centroids_.size(),
+                        node_shape_feats, node_knn_points, node_knn_feats,
+                        encoding_time, hidden_feat_dir);
+    };
+
+    bool ShapeEncoder::precompute_pyramid(const std::vector<float> &xyz,
+                                          const std::vector<int> &length_vec,
+                                          const std::vector<uint32_t> &labels,
+                                          StackPyramid &pyramid, bool own_points)
+    {
+        long X = labels.size();     // point cloud number
         open3d::utility::Timer timer;
         std::stringstream msg;
 
-        timer.Start();
-        std::vector<at::Tensor> points_list;
-        std::vector<at::Tensor> lengths_list;
-        std::vector<at::Tensor> neighbors_list;
-        std::vector<at::Tensor> subsampling_list;
-        std::vector<at::Tensor> upsampling_list;
-        at::Tensor points_feats = torch::ones({X, 1}, torch::kFloat32);//.to(cuda_device_string);
-
-        //
-        float xyz_arr[X][3];
         int B = length_vec.size();
-        at::Tensor lengths= torch::zeros({B}, torch::kInt64);
-        if(B==1) lengths[0] = length_vec[0];
-        else if(B==2) {
-            float length_arr[] = {length_vec[0], length_vec[1]};
-            lengths = torch::from_blob(length_arr, {B}).to(torch::kInt64);
-        }
-        else{
+        if(B<1 || B>2 || xyz.size()!=3*X){
             std::cerr<<"Invalid length vector size.\n";
             assert(false);
-            return;
+            return false;
         }
 
-        for (int i = 0; i < X; i++)
-        {
-            xyz_arr[i][0] = xyz[i][0];
-            xyz_arr[i][1] = xyz[i][1];
-            xyz_arr[i][2] = xyz[i][2];
-        }
-        at::Tensor points = torch::from_blob(xyz_arr, {X, 3}).to(torch::kFloat32);
+        timer.Start();
+        std::vector<int64_t> length_arr(length_vec.begin(), length_vec.end());
+        at::Tensor lengths = torch::from_blob(length_arr.data(), {B}, torch::kInt64).clone();
+
+        // Wrap the caller's buffer without copying unless the pyramid has to outlive it.
+        at::Tensor points = torch::from_blob(const_cast<float*>(xyz.data()), {X, 3}, torch::kFloat32);
+        if(own_points) points = points.clone();
+
+        pyramid.clear();
+        precompute_data_stack_mode(points, lengths, pyramid.points_list, pyramid.lengths_list,
+                                    pyramid.neighbors_list, pyramid.subsampling_list, pyramid.upsampling_list);
         timer.Stop();
-        msg<<"concat: "
-            <<std::fixed<<std::setprecision(1)
-            <<timer.GetDurationInMillisecond()<<" ms, ";
+        msg<<"precompute: "<<std::fixed<<std::setprecision(1)<<timer.GetDurationInMillisecond()<<" ms, ";
 
         timer.Start();
-        precompute_data_stack_mode(points, lengths, points_list, lengths_list, neighbors_list, subsampling_list, upsampling_list);
+        associate_f_points(points, lengths, labels, pyramid.points_list[1], pyramid.lengths_list[1], pyramid.labels_f);
         timer.Stop();
-        msg<<"precompute: "<<timer.GetDurationInMillisecond()<<" ms, ";
+        msg<<"associate: "<<timer.GetDurationInMillisecond()<<" ms";
+        std::cout<<msg.str()<<std::endl;
+        return true;
+    }
+
+    at::Tensor merge_stack_indices(const at::Tensor &ref_indices, const at::Tensor &src_indices,
+                                   const int64_t &ref_supports, const int64_t &src_supports)
+    {
+        // Stack-mode neighbor indices point into the stacked supports and use the support count as
+        // the shadow index. Shift src past the ref supports and move both shadows to the merged one.
+        int64_t shadow = ref_supports + src_supports;
+        at::Tensor ref_merged = ref_indices.to(torch::kInt64);
+        at::Tensor src_merged = src_indices.to(torch::kInt64);
+        ref_merged = ref_merged.masked_fill(ref_merged >= ref_supports, shadow);
+        src_merged = (src_merged + ref_supports).masked_fill(src_merged >= src_supports, shadow);
+
+        // The neighbor limit is shared, but each side may be narrower. Pad with the shadow index.
+        int64_t width = std::max(ref_merged.size(1), src_merged.size(1));
+        if(ref_merged.size(1) < width) ref_merged = at::constant_pad_nd(ref_merged, {0, width - ref_merged.size(1)}, shadow);
+        if(src_merged.size(1) < width) src_merged = at::constant_pad_nd(src_merged, {0, width - src_merged.size(1)}, shadow);
+        return torch::cat({ref_merged, src_merged}, 0);
+    }
+
+    void ShapeEncoder::merge_pyramids(const StackPyramid &ref_pyramid, const StackPyramid &src_pyramid,
+                                      const uint32_t &label_offset, StackPyramid &stack_pyramid) const
+    {
+        // Grid subsampling and radius search never cross batch boundaries in stack mode, so the
+        // merged pyramid equals the one computed on the concatenated clouds.
+        stack_pyramid.clear();
+        int S = ref_pyramid.points_list.size();
+        assert(S == src_pyramid.points_list.size());
+        std::vector<int64_t> ref_sizes(S), src_sizes(S);
+        for (int i = 0; i < S; i++)
+        {
+            ref_sizes[i] = ref_pyramid.points_list[i].size(0);
+            src_sizes[i] = src_pyramid.points_list[i].size(0);
+            stack_pyramid.points_list.push_back(torch::cat({ref_pyramid.points_list[i], src_pyramid.points_list[i]}, 0));
+            stack_pyramid.lengths_list.push_back(torch::cat({ref_pyramid.lengths_list[i], src_pyramid.lengths_list[i]}, 0));
+        }
+
+        for (int i = 0; i < S; i++)
+        {
+            stack_pyramid.neighbors_list.push_back(merge_stack_indices(ref_pyramid.neighbors_list[i], src_pyramid.neighbors_list[i],
+                                                                        ref_sizes[i], src_sizes[i]));
+            if (i < S - 1)
+            {
+                stack_pyramid.subsampling_list.push_back(merge_stack_indices(ref_pyramid.subsampling_list[i], src_pyramid.subsampling_list[i],
+                                                                              ref_sizes[i], src_sizes[i]));
+                stack_pyramid.upsampling_list.push_back(merge_stack_indices(ref_pyramid.upsampling_list[i], src_pyramid.upsampling_list[i],
+                                                                             ref_sizes[i + 1], src_sizes[i + 1]));
+            }
+        }
+
+        stack_pyramid.labels_f = torch::cat({ref_pyramid.labels_f, src_pyramid.labels_f + int(label_offset)}, 0);
+    }
+
+    void ShapeEncoder::encode_pyramid(const StackPyramid &pyramid,
+                                      const std::vector<uint32_t> &nodes,
+                                      long N,
+                                      torch::Tensor &node_shape_feats, 
+                                      torch::Tensor &node_knn_points, 
+                                      torch::Tensor &node_knn_feats,
+                                      float &encoding_time,
+                                      std::string hidden_feat_dir)
+    {
+        c10::InferenceMode guard;
+        const std::vector<at::Tensor> &points_list = pyramid.points_list;
+        const std::vector<at::Tensor> &neighbors_list = pyramid.neighbors_list;
+        const std::vector<at::Tensor> &subsampling_list = pyramid.subsampling_list;
+        const std::vector<at::Tensor> &upsampling_list = pyramid.upsampling_list;
+        long X = points_list[0].size(0); // point cloud number
+        open3d::utility::Timer timer;
+        std::stringstream msg;
 
         //
         timer.Start();
-        at::Tensor labels_f = torch::zeros({points_list[1].size(0)}, torch::kInt32);
+        at::Tensor points_feats = torch::ones({X, 1}, torch::kFloat32);//.to(device_string);
         at::Tensor node_point_indices = torch::zeros({N, config.K_shape_samples}, torch::kInt32);
         at::Tensor node_knn_indices = torch::zeros({N, config.K_match_samples}, torch::kInt32);
-        associate_f_points(xyz, labels, points_list[1], labels_f);
-        timer.Stop();
-        msg<<"associate: "<<timer.GetDurationInMillisecond()<<" ms, ";
+        sample_node_f_points(pyramid.labels_f, nodes, node_point_indices, node_knn_indices);
 
-        timer.Start();
-        sample_node_f_points(labels_f, nodes, node_point_indices, config.K_shape_samples);
-        sample_node_f_points(labels_f, nodes, node_knn_indices, config.K_match_samples, 1);
-
-        
-        torch::Tensor nodes_feats = torch::ones({N}, torch::kFloat32).to(cuda_device_string);
-        // node_point_indices = node_point_indices.to(cuda_device_string);
-        node_knn_indices = node_knn_indices.to(cuda_device_string);
+        // node_point_indices = node_point_indices.to(device_string);
+        node_knn_indices = node_knn_indices.to(device_string);
         timer.Stop();
-        msg<<"sampling: "<<timer.GetDurationInMillisecond()<<" ms, ";
+        msg<<"sampling: "<<std::fixed<<std::setprecision(1)<<timer.GetDurationInMillisecond()<<" ms, ";
 
         //
         timer.Start();
         torch::Tensor f_points_feats;
-        auto output = encoder_v2({points_feats.to(cuda_device_string),
-                                points_list[0].to(torch::kFloat32).to(cuda_device_string),
-                                points_list[1].to(torch::kFloat32).to(cuda_device_string),
-                                points_list[2].to(torch::kFloat32).to(cuda_device_string),
-                                points_list[3].to(torch::kFloat32).to(cuda_device_string),
-                                neighbors_list[0].to(torch::kInt64).to(cuda_device_string),
-                                neighbors_list[1].to(torch::kInt64).to(cuda_device_string),
-                                neighbors_list[2].to(torch::kInt64).to(cuda_device_string),
-                                neighbors_list[3].to(torch::kInt64).to(cuda_device_string),
-                                subsampling_list[0].to(torch::kInt64).to(cuda_device_string),
-                                subsampling_list[1].to(torch::kInt64).to(cuda_device_string),
-                                subsampling_list[2].to(torch::kInt64).to(cuda_device_string),
-                                upsampling_list[0].to(torch::kInt64).to(cuda_device_string),
-                                upsampling_list[1].to(torch::kInt64).to(cuda_device_string),
-                                upsampling_list[2].to(torch::kInt64).to(cuda_device_string),
-                                node_point_indices.to(cuda_device_string)}).toTuple();
+        auto output = encoder_v2.forward({points_feats.to(device_string),
+                                points_list[0].to(torch::kFloat32).to(device_string),
+                                points_list[1].to(torch::kFloat32).to(device_string),
+                                points_list[2].to(torch::kFloat32).to(device_string),
+                                points_list[3].to(torch::kFloat32).to(device_string),
+                                neighbors_list[0].to(torch::kInt64).to(device_string),
+                                neighbors_list[1].to(torch::kInt64).to(device_string),
+                                neighbors_list[2].to(torch::kInt64).to(device_string),
+                                neighbors_list[3].to(torch::kInt64).to(device_string),
+                                subsampling_list[0].to(torch::kInt64).to(device_string),
+                                subsampling_list[1].to(torch::kInt64).to(device_string),
+                                subsampling_list[2].to(torch::kInt64).to(device_string),
+                                upsampling_list[0].to(torch::kInt64).to(device_string),
+                                upsampling_list[1].to(torch::kInt64).to(device_string),
+                                upsampling_list[2].to(torch::kInt64).to(device_string),
+                                node_point_indices.to(device_string)}).toTuple();
         node_shape_feats = output->elements()[0].toTensor();
         f_points_feats = output->elements()[1].toTensor();
         
@@ -142,8 +212,8 @@ namespace fmfusion
 
         //
         timer.Start();
-        torch::Tensor padded_points_f = torch::cat({points_list[1], torch::zeros({1, 3}, torch::kFloat32)}, 0).to(cuda_device_string);
-        torch::Tensor padded_feats_f = torch::cat({f_points_feats, torch::zeros({1, f_points_feats.size(1)}, torch::kFloat32).to(cuda_device_string)}, 0);
+        torch::Tensor padded_points_f = torch::cat({points_list[1], torch::zeros({1, 3}, torch::kFloat32)}, 0).to(device_string);
+        torch::Tensor padded_feats_f = torch::cat({f_points_feats, torch::zeros({1, f_points_feats.size(1)}, torch::kFloat32).to(device_string)}, 0);
         node_knn_points = torch::index_select(padded_points_f, 0, node_knn_indices.view(-1)).view({N, config.K_match_samples, -1});
         node_knn_feats = torch::index_select(padded_feats_f, 0, node_knn_indices.view(-1)).view({N, config.K_match_samples, -1});
         timer.Stop();
@@ -241,69 +311,170 @@ namespace fmfusion
         }
     };
 
-    void ShapeEncoder::associate_f_points(const std::vector<Eigen::Vector3d> &xyz, const std::vector<uint32_t> &labels,
-                                          const at::Tensor &points_f, at::Tensor &labels_f)
+    void ShapeEncoder::associate_f_points(const at::Tensor &points, const at::Tensor &lengths,
+                                          const std::vector<uint32_t> &labels,
+                                          const at::Tensor &points_f, const at::Tensor &lengths_f,
+                                          at::Tensor &labels_f)
     {
-        int Xf = points_f.size(0);
-        // std::cout<<"Xf: "<<Xf<<std::endl;
-        open3d::geometry::PointCloud pcd(xyz);
-        open3d::geometry::KDTreeFlann kdtree(pcd);
-        float SEARCH_RADIUS = 0.5;
-        float labels_f_array[Xf];
+        // Each subsampled point is the barycenter of the dense points in its voxel of the first
+        // grid_subsampling stage, so it falls in that same voxel. Vote a majority label per voxel
+        // and look the f points up by voxel key instead of running a KNN query per point.
+        float voxel_size = 2 * config.init_voxel_size;
+        long X = points.size(0);
+        long Xf = points_f.size(0);
+        int B = lengths.size(0);
+        at::Tensor points_f_c = points_f.contiguous();
+        at::Tensor lengths_c = lengths.to(torch::kInt64).contiguous();
+        at::Tensor lengths_f_c = lengths_f.to(torch::kInt64).contiguous();
+        const float *xyz = points.data_ptr<float>();
+        const float *xyz_f = points_f_c.data_ptr<float>();
+        const int64_t *length_ptr = lengths_c.data_ptr<int64_t>();
+        const int64_t *length_f_ptr = lengths_f_c.data_ptr<int64_t>();
+
+        std::vector<std::pair<uint64_t, uint32_t>> voxel_votes(X); // (voxel key, label)
+        long begin = 0;
+        for (int b = 0; b < B; b++)
+        {
+            long stop = begin + length_ptr[b];
+#pragma omp parallel for default(none) shared(begin, stop, b, xyz, labels, voxel_votes, voxel_size)
+            for (long k = begin; k < stop; k++)
+                voxel_votes[k] = std::make_pair(voxel_key(xyz + 3 * k, voxel_size, b), labels[k]);
+            begin = stop;
+        }
+        std::sort(voxel_votes.begin(), voxel_votes.end());
 
-        for (int i = 0; i < Xf; i++)
+        // Majority label of each voxel. Equal (key, label) pairs are adjacent after sorting.
+        std::vector<uint64_t> voxel_keys;
+        std::vector<uint32_t> voxel_labels;
+        size_t k = 0;
+        while (k < voxel_votes.size())
         {
-            float x = points_f[i][0].item<float>();
-            float y = points_f[i][1].item<float>();
-            float z = points_f[i][2].item<float>();
-            Eigen::Vector3d query_point(x, y, z);
+            uint64_t key = voxel_votes[k].first;
+            uint32_t best_label = voxel_votes[k].second;
+            size_t best_count = 0;
+            while (k < voxel_votes.size() && voxel_votes[k].first == key)
+            {
+                size_t run = k;
+                while (run < voxel_votes.size() && voxel_votes[run] == voxel_votes[k]) run++;
+                if (run - k > best_count)
+                {
+                    best_count = run - k;
+                    best_label = voxel_votes[k].second;
+                }
+                k = run;
+            }
+            voxel_keys.push_back(key);
+            voxel_labels.push_back(best_label);
+        }
+
+        labels_f = torch::empty({Xf}, torch::kInt32); // written in place, no stack array
+        int32_t *labels_f_ptr = labels_f.data_ptr<int32_t>();
+        begin = 0;
+        for (int b = 0; b < B; b++)
+        {
+            long stop = begin + length_f_ptr[b];
+#pragma omp parallel for default(none) shared(begin, stop, b, xyz_f, voxel_keys, voxel_labels, labels_f_ptr, voxel_size)
+            for (long i = begin; i < stop; i++)
+            {
+                uint64_t key = voxel_key(xyz_f + 3 * i, voxel_size, b);
+                auto it = std::lower_bound(voxel_keys.begin(), voxel_keys.end(), key);
+                if (it != voxel_keys.end() && *it == key) labels_f_ptr[i] = voxel_labels[it - voxel_keys.begin()];
+                else labels_f_ptr[i] = -1;
+            }
+            begin = stop;
+        }
+
+        // Points pushed across a voxel boundary by float rounding fall back to the nearest dense point.
+        std::vector<long> missed;
+        for (long i = 0; i < Xf; i++)
+            if (labels_f_ptr[i] < 0) missed.push_back(i);
+        if (missed.empty()) return;
+
+        float SEARCH_RADIUS = 0.5;
+        Eigen::Map<const Eigen::Matrix<float, 3, Eigen::Dynamic>> xyz_map(xyz, 3, X);
+        open3d::geometry::KDTreeFlann kdtree(Eigen::MatrixXd(xyz_map.cast<double>()));
+        for (long i : missed)
+        {
+            Eigen::Vector3d query_point(xyz_f[3 * i], xyz_f[3 * i + 1], xyz_f[3 * i + 2]);
             std::vector<int> q_indices;
             std::vector<double> q_distances;
 
             int result = kdtree.SearchKNN(query_point, 1, q_indices, q_distances);
             assert(result > 0);
             assert(q_distances[0] < SEARCH_RADIUS);
-            // labels_f[i] = labels[q_indices[0]];
-            labels_f_array[i] = labels[q_indices[0]];
+            labels_f_ptr[i] = labels[q_indices[0]];
         }
-
-        labels_f = torch::from_blob(labels_f_array, {Xf}).to(torch::kInt32);
-
     }
 
     void ShapeEncoder::sample_node_f_points(const at::Tensor &labels_f, const std::vector<uint32_t> &nodes,
-                                            at::Tensor &node_f_points, int K, int padding_mode)
+                                            at::Tensor &node_shape_indices, at::Tensor &node_knn_indices)
     {
         int Nf = labels_f.size(0);
-        for (const uint32_t node_id : nodes)
+        int N = node_shape_indices.size(0);
+        int K_shape = node_shape_indices.size(1);
+        int K_match = node_knn_indices.size(1);
+        const int32_t *label_ptr = labels_f.data_ptr<int32_t>();
+        int32_t *shape_ptr = node_shape_indices.data_ptr<int32_t>();
+        int32_t *knn_ptr = node_knn_indices.data_ptr<int32_t>();
+        bool random_padding = config.padding == "random";
+        int sample_seed = config.sample_seed;
+
+        // Counting sort: group the f point indices by node label in one pass.
+        std::vector<int32_t> offsets(N + 1, 0);
+        for (int i = 0; i < Nf; i++)
+            if (label_ptr[i] >= 0 && label_ptr[i] < N) offsets[label_ptr[i] + 1]++;
+        for (int n = 0; n < N; n++) offsets[n + 1] += offsets[n];
+        std::vector<int32_t> buckets(offsets[N]);
+        std::vector<int32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (int i = 0; i < Nf; i++)
+            if (label_ptr[i] >= 0 && label_ptr[i] < N) buckets[cursor[label_ptr[i]]++] = i;
+
+        // Sample each node independently. The RNG is seeded by (seed, node, stream), so the result
+        // does not depend on the thread schedule.
+#pragma omp parallel default(none) shared(nodes, offsets, buckets, shape_ptr, knn_ptr, N, Nf, K_shape, K_match, random_padding, sample_seed)
         {
-            // Find the labels that equal to node_id
-            at::Tensor mask = labels_f.eq(node_id);
-            at::Tensor node_points = mask.nonzero().squeeze(1);
-            if (node_points.size(0) < K)
-            { // padding the small instances
-                int padding = K - node_points.size(0);
-                at::Tensor padding_points = torch::zeros({padding}, torch::kInt32);
-                if (padding_mode == 0){
-                    if (config.padding=="zero") padding_points.fill_(node_points[0]);
-                    else if(config.padding=="random"){
-                        torch::Tensor node_weights = torch::ones_like(node_points).to(torch::kFloat32) / node_points.size(0);
-                        padding_points = node_points.index_select(0, torch::multinomial(node_weights, padding, true));
-                        // padding_points = torch::multinomial(node_weights, padding, true);
+            std::vector<int32_t> scratch;
+#pragma omp for schedule(dynamic, 4)
+            for (size_t k = 0; k < nodes.size(); k++)
+            {
+                uint32_t node_id = nodes[k];
+                if (node_id >= (uint32_t)N) continue;
+                const int32_t *node_points = buckets.data() + offsets[node_id];
+                int count = offsets[node_id + 1] - offsets[node_id];
+                int32_t *shape_row = shape_ptr + (size_t)node_id * K_shape;
+                int32_t *knn_row = knn_ptr + (size_t)node_id * K_match;
+
+                for (int stream = 0; stream < 2; stream++)
+                {
+                    int K = stream == 0 ? K_shape : K_match;
+                    int32_t *row = stream == 0 ? shape_row : knn_row;
+                    std::seed_seq seq{sample_seed, int(node_id), stream};
+                    std::mt19937 rng(seq);
+
+                    if (count > K)
+                    { // random sample K points (partial Fisher-Yates)
+                        scratch.assign(node_points, node_points + count);
+                        for (int j = 0; j < K; j++)
+                        {
+                            std::uniform_int_distribution<int> dist(j, count - 1);
+                            std::swap(scratch[j], scratch[dist(rng)]);
+                        }
+                        std::copy(scratch.begin(), scratch.begin() + K, row);
+                        continue;
                     }
+
+                    // padding the small instances
+                    std::copy(node_points, node_points + count, row);
+                    if (stream == 1) std::fill(row + count, row + K, Nf);
+                    else if (count == 0) std::fill(row, row + K, 0);
+                    else if (random_padding)
+                    {
+                        std::uniform_int_distribution<int> dist(0, count - 1);
+                        for (int j = count; j < K; j++) row[j] = node_points[dist(rng)];
+                    }
+                    else std::fill(row + count, row + K, node_points[0]);
                 }
-                else if (padding_mode == 1)
-                    padding_points.fill_(Nf);
-                node_points = torch::cat({node_points, padding_points}, 0);
-            }
-            else
-            {                                                                                    // random sample K points
-                node_points = node_points.index_select(0, torch::randperm(node_points.size(0))); // reorder
-                node_points = node_points.slice(0, 0, K);                                        // sample K points
             }
-            node_f_points[node_id] = node_points;
-
-            // std::cout<<"Node "<<node_id<<" has "<<node_points.size(0)<<" points\n";
         }
     }
 
@@ -8,6 +8,7 @@
 #include <open3d/Open3D.h>  // Open3D 라이브러리 (3D 데이터 처리)
 
 #include "Common.h"  // 공통 헤더 파일
+#include "sgloop/InferenceSession.h"  // 추론 세션 헤더 파일
 #include "thirdparty/extensions/cpu/grid_subsampling.h"  // 서브샘플링을 위한 외부 확장
 #include "thirdparty/extensions/cpu/radius_neighbors.h"  // 반경 이웃 탐색을 위한 외부 확장
 
@@ -21,23 +22,53 @@ namespace fmfusion
                         float radius, 
                         int neighbor_limit);
 
+    /// \brief  스택 모드 다중 스케일 피라미드와 f_points의 노드 라벨.
+    ///         그래프별로 따로 계산한 뒤 인덱스 오프셋으로 병합할 수 있음
+    struct StackPyramid
+    {
+        std::vector<at::Tensor> points_list;  // (X_i,3) 단계별 포인트
+        std::vector<at::Tensor> lengths_list;  // (B,) 단계별 배치 길이
+        std::vector<at::Tensor> neighbors_list;  // 단계별 반경 이웃
+        std::vector<at::Tensor> subsampling_list;  // i -> i+1 단계 풀링 인덱스
+        std::vector<at::Tensor> upsampling_list;  // i+1 -> i 단계 업샘플링 인덱스
+        at::Tensor labels_f;  // (Xf,) 1단계 포인트의 노드 라벨
+
+        bool empty() const { return points_list.empty(); }
+        void clear() {
+            points_list.clear();
+            lengths_list.clear();
+            neighbors_list.clear();
+            subsampling_list.clear();
+            upsampling_list.clear();
+            labels_f = at::Tensor();
+        }
+    };
+
+    // 두 그래프의 스택 모드 인덱스를 병합 (src 인덱스 이동, 패딩 인덱스 통일)
+    at::Tensor merge_stack_indices(const at::Tensor &ref_indices, const at::Tensor &src_indices,
+                                   const int64_t &ref_supports, const int64_t &src_supports);
+
+    // 포인트가 속한 복셀 키 (grid_subsampling과 같은 격자)
+    uint64_t voxel_key(const float *p, const float &voxel_size, const int &batch);
+
     // ShapeEncoder 클래스 정의
     class ShapeEncoder
     {
     /// \brief  하나의 씬 그래프에 대한 shape encoder
     public:
-        // 생성자: ShapeEncoderConfig와 weight 폴더, CUDA 장치 번호를 입력받음
-        ShapeEncoder(const ShapeEncoderConfig &config_, const std::string weight_folder, int cuda_number=0);
+        // 생성자: ShapeEncoderConfig와 weight 폴더, 추론 장치 문자열("cuda:N" 또는 "cpu")을 입력받음
+        ShapeEncoder(const ShapeEncoderConfig &config_, const std::string weight_folder, const std::string &device="cuda:0");
         
         // 소멸자
         ~ShapeEncoder(){};
 
         /// \brief  씬 그래프의 형상(Shape)을 인코딩하는 함수
-        /// \param  xyz_        (X,3), 씬 그래프의 포인트 클라우드
-        /// \param  labels_     (X,), 각 포인트의 노드 인덱스
+        /// \param  xyz         (X*3,), 씬 그래프의 포인트 클라우드. 행 우선 float32 연속 배열이며 복사 없이 텐서로 감쌈
+        /// \param  length_vec  (B,), 각 씬 그래프의 포인트 수
+        /// \param  labels      (X,), 각 포인트의 노드 인덱스
         /// \param  centroids_  (N,3), 각 노드의 중심점
         /// \param  nodes       (N,), 각 노드의 인덱스
-        void encode(const std::vector<Eigen::Vector3d> &xyz, const std::vector<int> &length_vec, const std::vector<uint32_t> &labels, 
+        void encode(const std::vector<float> &xyz, const std::vector<int> &length_vec, const std::vector<uint32_t> &labels, 
                     const std::vector<Eigen::Vector3d> &centroids_, const std::vector<uint32_t> &nodes,
                     torch::Tensor &node_shape_feats, 
                     torch::Tensor &node_knn_points,
@@ -45,6 +76,32 @@ namespace fmfusion
                     float &encoding_time,
                     std::string hidden_feat_dir="");
 
+        /// \brief  포인트 클라우드의 스택 모드 피라미드를 계산하고 f_points에 노드 라벨을 부여
+        /// \param  own_points  true이면 입력 버퍼를 복사하여 피라미드가 xyz보다 오래 유지될 수 있음
+        bool precompute_pyramid(const std::vector<float> &xyz, const std::vector<int> &length_vec,
+                                const std::vector<uint32_t> &labels,
+                                StackPyramid &pyramid, bool own_points=false);
+
+        /// \brief  ref와 src 피라미드를 하나의 스택 피라미드로 병합. src 인덱스와 라벨은 오프셋만큼 이동
+        /// \param  label_offset  src 노드 라벨 오프셋 (ref 노드 수)
+        void merge_pyramids(const StackPyramid &ref_pyramid, const StackPyramid &src_pyramid,
+                            const uint32_t &label_offset, StackPyramid &stack_pyramid) const;
+
+        /// \brief  미리 계산된 피라미드로 노드 형상을 인코딩
+        /// \param  N  노드 수
+        void encode_pyramid(const StackPyramid &pyramid, const std::vector<uint32_t> &nodes, long N,
+                    torch::Tensor &node_shape_feats, 
+                    torch::Tensor &node_knn_points,
+                    torch::Tensor &node_knn_feats,
+                    float &encoding_time,
+                    std::string hidden_feat_dir="");
+
+        // 인코더의 누적 지연 시간을 반환하는 함수
+        std::string print_latency() const { return " - " + encoder_v2.print_latency() + "\n"; }
+
+        // CUDA 동기화로 커널 시간까지 측정할지 설정하는 함수
+        void set_synchronize(bool synchronize) { encoder_v2.set_synchronize(synchronize); }
+
     private:
         // 데이터 전처리 및 스택 모드로 준비하는 함수
         void precompute_data_stack_mode(at::Tensor points, at::Tensor lengths,
@@ -54,19 +111,22 @@ namespace fmfusion
                                         std::vector<at::Tensor> &subsampling_list,
                                         std::vector<at::Tensor> &upsampling_list);
 
-        // f_points와 레이블을 연관시키는 함수
-        void associate_f_points(const std::vector<Eigen::Vector3d> &xyz, const std::vector<uint32_t> &labels, 
-                    const at::Tensor &points_f, at::Tensor &labels_f);
+        // f_points와 레이블을 연관시키는 함수. 첫 번째 서브샘플링의 복셀별 다수결 라벨을 사용
+        void associate_f_points(const at::Tensor &points, const at::Tensor &lengths,
+                    const std::vector<uint32_t> &labels, 
+                    const at::Tensor &points_f, const at::Tensor &lengths_f, at::Tensor &labels_f);
 
-        // 노드 f_points 샘플링 함수
+        /// \brief 노드 f_points 샘플링 함수. 라벨별로 한 번에 버킷 정렬한 뒤 두 인덱스 텐서를 함께 채움
+        /// \param node_shape_indices (N, K_shape) 작은 노드는 config.padding 방식으로 채움
+        /// \param node_knn_indices   (N, K_match) 작은 노드는 Nf로 채움
         void sample_node_f_points(const at::Tensor &labels_f, const std::vector<uint32_t> &nodes,
-                                        at::Tensor &node_f_points, int K=512, int padding_mode=0);
+                                        at::Tensor &node_shape_indices, at::Tensor &node_knn_indices);
     
     private:
-        std::string cuda_device_string;  // CUDA 디바이스 문자열
+        std::string device_string;  // 추론 장치 문자열
         ShapeEncoderConfig config;  // ShapeEncoder 설정
         torch::jit::script::Module encoder; // 더 이상 사용되지 않음
-        torch::jit::script::Module encoder_v2;  // 새로운 버전의 encoder
+        InferenceModule encoder_v2{"shape_encoder_v2"};  // 새로운 버전의 encoder
 
     };
     
@@ -10,8 +10,12 @@
  */
 
 #include "bert_tokenizer.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
 #include <cwctype>
 #include <fstream>
+#include <functional>
 
 #include "basic_string_util.h"
 #include "logging.h"
@@ -34,18 +38,77 @@ static std::unordered_set<uint16_t> kChinesePunts = {
 // 단어 당 최대 문자 수를 설정합니다.
 static int kMaxCharsPerWords = 100;
 
+// 바이너리 어휘 파일의 식별자와 버전
+static const uint32_t kBinaryMagic = 0x43564252;  // "RBVC"
+static const uint32_t kBinaryVersion = 2;
+
+// FNV-1a 64비트 해시. 어휘 파일 내용과 바이너리 본문의 손상 검사에 사용
+static uint64_t content_hash(const char* data, size_t size) {
+  uint64_t hash = 1469598103934665603ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// 정수를 리틀 엔디언 바이트로 추가 (구조체 패딩 없이 필드별로 직렬화)
+template <typename T>
+static void put_le(std::string& buf, T value) {
+  for (size_t i = 0; i < sizeof(T); i++) {
+    buf.push_back(static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff));
+  }
+}
+
+// 버퍼에서 리틀 엔디언 정수를 읽음. 버퍼 끝을 넘으면 false
+template <typename T>
+static bool get_le(const std::string& buf, size_t& pos, T& value) {
+  if (buf.size() - pos < sizeof(T)) {
+    return false;
+  }
+  uint64_t v = 0;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    v |= static_cast<uint64_t>(static_cast<unsigned char>(buf[pos + i])) << (8 * i);
+  }
+  value = static_cast<T>(v);
+  pos += sizeof(T);
+  return true;
+}
+
 // 초기화 함수: 주어진 어휘 파일을 읽어서 토크나이저를 초기화합니다.
+// 캐시 디렉터리가 설정되어 있고 그 안의 "<vocab 이름>.bin"이 같은 어휘 내용에서 만들어졌으면
+// 텍스트 파싱 없이 바로 로드하고, 아니면 텍스트에서 만든 뒤 캐시에 저장합니다.
 bool BertTokenizer::Init(std::string vocab_file) {
   // 어휘 파일을 열고 읽습니다.
-  std::ifstream ifs(vocab_file);
+  std::ifstream ifs(vocab_file, std::ios::binary);
   if (!ifs) {  // 파일 열기에 실패하면 false 반환
     return false;
   }
   // 파일의 내용을 읽어서 content에 저장합니다.
   std::string content((std::istreambuf_iterator<char>(ifs)),
                       (std::istreambuf_iterator<char>()));
+
+  std::string binary_file;
+  uint64_t source_hash = 0;
+  if (!cache_dir_.empty()) {
+    size_t slash = vocab_file.find_last_of('/');
+    binary_file = cache_dir_ + "/" +
+                  (slash == std::string::npos ? vocab_file : vocab_file.substr(slash + 1)) + ".bin";
+    source_hash = content_hash(content.data(), content.size());
+    if (LoadBinary(binary_file, content.size(), source_hash)) {
+      return true;
+    }
+  }
+
   // 파일 내용으로부터 초기화합니다.
-  return InitByFileContent(content);
+  if (!InitByFileContent(content)) {
+    return false;
+  }
+  // 다음 실행을 위해 바이너리 어휘 사전 저장 (쓰기 권한이 없으면 무시)
+  if (!binary_file.empty()) {
+    SaveBinary(binary_file, content.size(), source_hash);
+  }
+  return true;
 }
 
 // 파일 내용으로부터 초기화하는 함수
@@ -58,29 +121,232 @@ bool BertTokenizer::InitByFileContent(std::string content) {
   // 분리된 줄을 바탕으로 초기화합니다.
   init_from_lines(lines);
 
-  // 각 토큰이 어휘 사전에 존재하는지 확인합니다.
-  if (token_2_id_map_.find(kPadToken) == token_2_id_map_.end()) {
-    return false;  // PadToken이 없으면 초기화 실패
+  // 트라이를 만들고 각 특수 토큰이 어휘 사전에 존재하는지 확인합니다.
+  build_trie_();
+  return resolve_special_ids_();
+}
+
+// 토큰 리스트에서 트라이를 만드는 함수
+void BertTokenizer::build_trie_() {
+  // 토큰을 사전 순으로 정렬. 같은 토큰이 여러 번 있으면 마지막 ID를 사용 (기존 맵과 동일)
+  std::vector<int> order(tokens_.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(),
+                   [this](int a, int b) { return tokens_[a] < tokens_[b]; });
+
+  trie_nodes_.clear();
+  trie_edges_.clear();
+  trie_nodes_.reserve(tokens_.size() * 4);
+  trie_edges_.reserve(tokens_.size() * 4);
+
+  // [lo, hi) 범위의 토큰은 앞의 depth 바이트를 공유. 자식 간선을 연속으로 예약한 뒤 재귀
+  std::function<int32_t(size_t, size_t, size_t)> build = [&](size_t lo, size_t hi, size_t depth) {
+    int32_t node = trie_nodes_.size();
+    trie_nodes_.push_back({-1, 0, 0});
+    while (lo < hi && tokens_[order[lo]].size() == depth) {
+      trie_nodes_[node].token_id = order[lo];
+      lo++;
+    }
+    std::vector<std::pair<size_t, size_t>> groups;
+    for (size_t i = lo; i < hi;) {
+      size_t j = i + 1;
+      uint8_t c = tokens_[order[i]][depth];
+      while (j < hi && static_cast<uint8_t>(tokens_[order[j]][depth]) == c) j++;
+      groups.emplace_back(i, j);
+      i = j;
+    }
+    uint32_t edge_begin = trie_edges_.size();
+    trie_nodes_[node].edge_begin = edge_begin;
+    trie_nodes_[node].edge_count = groups.size();
+    trie_edges_.resize(edge_begin + groups.size());
+    for (size_t g = 0; g < groups.size(); g++) {
+      uint8_t c = tokens_[order[groups[g].first]][depth];
+      int32_t child = build(groups[g].first, groups[g].second, depth + 1);
+      trie_edges_[edge_begin + g] = {c, child};
+    }
+    return node;
+  };
+  build(0, order.size(), 0);
+}
+
+// 서브 토큰 검색의 시작점과 특수 토큰 ID를 찾는 함수
+bool BertTokenizer::resolve_special_ids_() {
+  if (trie_nodes_.empty()) {
+    return false;
+  }
+  suffix_root_ = 0;
+  for (char c : std::string("##")) {
+    suffix_root_ = trie_child_(suffix_root_, c);
+    if (suffix_root_ < 0) break;
   }
-  if (token_2_id_map_.find(kUnkToken) == token_2_id_map_.end()) {
-    return false;  // UnkToken이 없으면 초기화 실패
+
+  pad_id_ = find_token_(kPadToken);
+  unk_id_ = find_token_(kUnkToken);
+  cls_id_ = find_token_(kClsToken);
+  sep_id_ = find_token_(kSepToken);
+  mask_id_ = find_token_(kMaskToken);
+
+  // 특수 토큰이 없으면 초기화 실패
+  if (pad_id_ < 0 || unk_id_ < 0 || cls_id_ < 0 || sep_id_ < 0 || mask_id_ < 0) {
+    return false;
   }
-  if (token_2_id_map_.find(kClsToken) == token_2_id_map_.end()) {
-    return false;  // ClsToken이 없으면 초기화 실패
+  // PadToken의 id 값이 0인지 확인합니다.
+  return pad_id_ == 0;
+}
+
+int32_t BertTokenizer::trie_child_(int32_t node, uint8_t c) const {
+  const TrieNode& n = trie_nodes_[node];
+  const TrieEdge* first = trie_edges_.data() + n.edge_begin;
+  const TrieEdge* last = first + n.edge_count;
+  const TrieEdge* it = std::lower_bound(
+      first, last, c, [](const TrieEdge& e, uint8_t b) { return e.byte < b; });
+  if (it == last || it->byte != c) {
+    return -1;
   }
-  if (token_2_id_map_.find(kSepToken) == token_2_id_map_.end()) {
-    return false;  // SepToken이 없으면 초기화 실패
+  return it->child;
+}
+
+int BertTokenizer::find_token_(const std::string& token) const {
+  if (trie_nodes_.empty()) {
+    return -1;
   }
-  if (token_2_id_map_.find(kMaskToken) == token_2_id_map_.end()) {
-    return false;  // MaskToken이 없으면 초기화 실패
+  int32_t node = 0;
+  for (char c : token) {
+    node = trie_child_(node, c);
+    if (node < 0) {
+      return -1;
+    }
   }
+  return trie_nodes_[node].token_id;
+}
 
-  // PadToken의 id 값이 0인지 확인합니다.
-  int v = token_2_id_map_.at(kPadToken);
-  if (v != 0) {
-    return false;  // PadToken의 id가 0이 아니면 초기화 실패
+// 로드한 트라이 검증: 자식 간선 범위, 토큰 ID, 자식 노드 인덱스, 간선의 바이트 순서
+bool BertTokenizer::validate_trie_() const {
+  if (trie_nodes_.empty()) {
+    return false;
   }
-  return true;  // 모든 조건을 통과하면 초기화 성공
+  const uint64_t num_nodes = trie_nodes_.size();
+  const uint64_t num_edges = trie_edges_.size();
+  for (const TrieNode& node : trie_nodes_) {
+    if (node.token_id < -1 || node.token_id >= static_cast<int64_t>(tokens_.size())) {
+      return false;
+    }
+    if (static_cast<uint64_t>(node.edge_begin) + node.edge_count > num_edges) {
+      return false;
+    }
+    for (uint32_t e = 1; e < node.edge_count; e++) {
+      if (trie_edges_[node.edge_begin + e - 1].byte >= trie_edges_[node.edge_begin + e].byte) {
+        return false;
+      }
+    }
+  }
+  for (const TrieEdge& edge : trie_edges_) {
+    // 루트(0)는 자식이 될 수 없음
+    if (edge.child <= 0 || static_cast<uint64_t>(edge.child) >= num_nodes) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 바이너리 어휘 사전 저장: 헤더, 토큰 문자열, 트라이 노드와 간선. 모든 필드를 리틀 엔디언으로 직렬화
+bool BertTokenizer::SaveBinary(const std::string& path, uint64_t source_size,
+                               uint64_t source_hash) const {
+  std::string buf;
+  buf.reserve(64 + tokens_.size() * 12 + trie_nodes_.size() * 12 + trie_edges_.size() * 5);
+  put_le<uint32_t>(buf, kBinaryMagic);
+  put_le<uint32_t>(buf, kBinaryVersion);
+  put_le<uint64_t>(buf, source_size);
+  put_le<uint64_t>(buf, source_hash);
+  put_le<uint64_t>(buf, 0);  // 본문 해시 자리. 본문을 쓴 뒤 채움
+  const size_t payload_hash_pos = buf.size() - sizeof(uint64_t);
+  const size_t payload_begin = buf.size();
+  put_le<uint64_t>(buf, tokens_.size());
+  put_le<uint64_t>(buf, trie_nodes_.size());
+  put_le<uint64_t>(buf, trie_edges_.size());
+  for (const std::string& token : tokens_) {
+    put_le<uint32_t>(buf, token.size());
+    buf.append(token);
+  }
+  for (const TrieNode& node : trie_nodes_) {
+    put_le<int32_t>(buf, node.token_id);
+    put_le<uint32_t>(buf, node.edge_begin);
+    put_le<uint32_t>(buf, node.edge_count);
+  }
+  for (const TrieEdge& edge : trie_edges_) {
+    put_le<uint8_t>(buf, edge.byte);
+    put_le<int32_t>(buf, edge.child);
+  }
+  std::string payload_hash;
+  put_le<uint64_t>(payload_hash, content_hash(buf.data() + payload_begin, buf.size() - payload_begin));
+  buf.replace(payload_hash_pos, payload_hash.size(), payload_hash);
+
+  // 임시 파일에 쓴 뒤 이름을 바꿔서 다른 프로세스가 쓰다 만 파일을 읽지 않도록 함
+  std::string tmp_path = path + ".tmp";
+  FILE* fp = fopen(tmp_path.c_str(), "wb");
+  if (fp == NULL) {
+    return false;
+  }
+  bool ok = fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+  ok = fclose(fp) == 0 && ok;
+  ok = ok && rename(tmp_path.c_str(), path.c_str()) == 0;
+  if (!ok) {
+    remove(tmp_path.c_str());  // 불완전한 파일은 남기지 않음
+  }
+  return ok;
+}
+
+bool BertTokenizer::LoadBinary(const std::string& path, uint64_t source_size,
+                               uint64_t source_hash) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs) {
+    return false;
+  }
+  std::string buf((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
+
+  size_t pos = 0;
+  uint32_t magic = 0, version = 0;
+  uint64_t size = 0, hash = 0, payload_hash = 0, num_tokens = 0, num_nodes = 0, num_edges = 0;
+  bool ok = get_le(buf, pos, magic) && get_le(buf, pos, version) && get_le(buf, pos, size) &&
+            get_le(buf, pos, hash) && get_le(buf, pos, payload_hash);
+  ok = ok && magic == kBinaryMagic && version == kBinaryVersion && size == source_size &&
+       hash == source_hash && payload_hash == content_hash(buf.data() + pos, buf.size() - pos);
+  ok = ok && get_le(buf, pos, num_tokens) && get_le(buf, pos, num_nodes) && get_le(buf, pos, num_edges);
+  // 개수가 남은 바이트 수보다 크면 손상된 헤더 (큰 할당 방지)
+  ok = ok && num_tokens <= buf.size() - pos && num_nodes <= (buf.size() - pos) / 12 &&
+       num_edges <= (buf.size() - pos) / 5;
+  if (ok) {
+    tokens_.resize(num_tokens);
+    for (std::string& token : tokens_) {
+      uint32_t len = 0;
+      ok = get_le(buf, pos, len) && len <= buf.size() - pos;
+      if (!ok) break;
+      token.assign(buf, pos, len);
+      pos += len;
+    }
+  }
+  if (ok) {
+    trie_nodes_.resize(num_nodes);
+    for (TrieNode& node : trie_nodes_) {
+      ok = get_le(buf, pos, node.token_id) && get_le(buf, pos, node.edge_begin) &&
+           get_le(buf, pos, node.edge_count);
+      if (!ok) break;
+    }
+  }
+  if (ok) {
+    trie_edges_.resize(num_edges);
+    for (TrieEdge& edge : trie_edges_) {
+      ok = get_le(buf, pos, edge.byte) && get_le(buf, pos, edge.child);
+      if (!ok) break;
+    }
+  }
+  ok = ok && pos == buf.size() && validate_trie_() && resolve_special_ids_();
+  if (!ok) {  // 손상되었거나 오래된 파일이면 텍스트에서 다시 만듦
+    tokens_.clear();
+    trie_nodes_.clear();
+    trie_edges_.clear();
+  }
+  return ok;
 }
 
 std::vector<int> BertTokenizer::Encode(std::string text) {
@@ -88,6 +354,13 @@ std::vector<int> BertTokenizer::Encode(std::string text) {
 
   std::vector<int> results;
 
+  // 영어 라벨처럼 ASCII로만 이루어진 텍스트는 NFD와 UTF-16 변환 없이 처리합니다.
+  if (std::all_of(text.begin(), text.end(),
+                  [](char c) { return static_cast<unsigned char>(c) < 0x80; })) {
+    encode_ascii_(text, results);
+    return results;
+  }
+
   // 텍스트에서 ASCII 문자를 제외한 공백을 제거합니다.
   text = BasicStringUtil::StripStringASCIIWhole(text);
 
@@ -134,7 +407,7 @@ std::vector<int> BertTokenizer::Encode(std::string text) {
   for (auto s : tokens) {
     // 토큰의 길이가 최대 길이를 초과하면 UNK 토큰을 추가합니다.
     if (s.size() > kMaxCharsPerWords) {
-      results.push_back(token_2_id_map_.at(kUnkToken));
+      results.push_back(unk_id_);
     } else {
       // 그렇지 않으면 max_seg_ 함수를 통해 세그먼트를 나누어 ID를 추가합니다.
       max_seg_(s, results);
@@ -145,52 +418,91 @@ std::vector<int> BertTokenizer::Encode(std::string text) {
   return results;
 }
 
-int BertTokenizer::PadId() const { return token_2_id_map_.at(kPadToken); }  // Pad 토큰의 ID를 반환
-int BertTokenizer::MaskId() const { return token_2_id_map_.at(kMaskToken); }  // Mask 토큰의 ID를 반환
-int BertTokenizer::SepId() const { return token_2_id_map_.at(kSepToken); }  // Sep 토큰의 ID를 반환
-int BertTokenizer::ClsId() const { return token_2_id_map_.at(kClsToken); }  // Cls 토큰의 ID를 반환
-int BertTokenizer::UnkId() const { return token_2_id_map_.at(kUnkToken); }  // Unk 토큰의 ID를 반환
+int BertTokenizer::PadId() const { return pad_id_; }  // Pad 토큰의 ID를 반환
+int BertTokenizer::MaskId() const { return mask_id_; }  // Mask 토큰의 ID를 반환
+int BertTokenizer::SepId() const { return sep_id_; }  // Sep 토큰의 ID를 반환
+int BertTokenizer::ClsId() const { return cls_id_; }  // Cls 토큰의 ID를 반환
+int BertTokenizer::UnkId() const { return unk_id_; }  // Unk 토큰의 ID를 반환
 
 int BertTokenizer::TotalSize() const { return tokens_.size(); }  // 총 토큰 수를 반환
 
-// 최대 길이로 분할하여 결과에 토큰 ID를 추가하는 함수
-void BertTokenizer::max_seg_(std::string s, std::vector<int>& results) {
-  int end = s.size();
-  int start = 0;
+// ASCII 구두점인지 확인하는 함수 (_is_punct_char의 ASCII 범위와 동일)
+static bool _is_ascii_punct(unsigned char c) {
+  return (c >= 33 && c <= 47) || (c >= 58 && c <= 64) || (c >= 91 && c <= 96) ||
+         (c >= 123 && c <= 126);
+}
+
+// ASCII 텍스트 처리: _clean, _basic_tokenize, 공백 분할과 같은 결과를 한 번의 순회로 만듭니다.
+void BertTokenizer::encode_ascii_(const std::string& text, std::vector<int>& results) const {
+  std::string word;
+  word.reserve(32);
+  auto flush = [&]() {
+    if (word.empty()) {
+      return;
+    }
+    if (word.size() > kMaxCharsPerWords) {
+      results.push_back(unk_id_);
+    } else {
+      max_seg_(word, results);
+    }
+    word.clear();
+  };
+
+  for (char ch : text) {
+    unsigned char c = static_cast<unsigned char>(ch);
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+      flush();  // 공백에서 단어 분리
+    } else if (c < 32 || c == 127) {
+      continue;  // 제어 문자 제거
+    } else if (_is_ascii_punct(c)) {
+      flush();  // 구두점은 하나의 단어
+      word.push_back(ch);
+      flush();
+    } else {
+      word.push_back(static_cast<char>(std::tolower(c)));
+    }
+  }
+  flush();
+}
+
+// 최대 길이로 분할하여 결과에 토큰 ID를 추가하는 함수.
+// 트라이를 한 번 따라가며 가장 긴 토큰을 찾으므로 후보 문자열을 만들지 않습니다.
+void BertTokenizer::max_seg_(const std::string& s, std::vector<int>& results) const {
+  size_t end = s.size();
+  size_t start = 0;
   bool firstOne = true;
-  // 시작 위치에서 끝까지 토큰을 분할하여 처리합니다.
   while (start < end) {
-    std::string test(s.c_str() + start, end - start);
-    if (!firstOne) {
-      test = std::string("##") + test;  // 첫 번째 이후에는 '##'를 추가하여 서브 토큰으로 처리
+    // 첫 번째 이후에는 '##' 노드에서 시작하여 서브 토큰으로 처리
+    int32_t node = firstOne ? 0 : suffix_root_;
+    int best_id = -1;
+    size_t best_end = start;
+    for (size_t i = start; i < end && node >= 0; i++) {
+      node = trie_child_(node, s[i]);
+      if (node >= 0 && trie_nodes_[node].token_id >= 0) {
+        best_id = trie_nodes_[node].token_id;
+        best_end = i + 1;
+      }
     }
-    auto it = token_2_id_map_.find(test);
-    if (it == token_2_id_map_.end()) {
-      end -= 1;  // 매칭되지 않으면 끝 위치를 한 칸 앞으로 이동
-    } else {
-      results.push_back(it->second);  // 매칭된 토큰의 ID를 결과에 추가
-      start = end;  // 분할을 종료
-      end = s.size();  // 끝 위치를 원래 텍스트의 끝으로 설정
-      firstOne = false;
+    if (best_id < 0) {
+      break;  // 매칭되는 토큰이 없으면 분할 종료
     }
+    results.push_back(best_id);  // 매칭된 토큰의 ID를 결과에 추가
+    start = best_end;
+    firstOne = false;
   }
   // 첫 번째 토큰이 매칭되지 않으면 UNK 토큰을 추가합니다.
   if (firstOne) {
-    results.push_back(token_2_id_map_.at(kUnkToken));
+    results.push_back(unk_id_);
   }
 }
 
 // 단어를 ID로 변환하는 함수
 int BertTokenizer::Word2Id(std::string s) const {
   if (s.size() > kMaxCharsPerWords) {  // 단어의 길이가 최대 길이를 초과하면 UNK 토큰을 반환
-    return token_2_id_map_.at(kUnkToken);
-  }
-  auto it = token_2_id_map_.find(s);
-  if (it == token_2_id_map_.end()) {  // 토큰이 없으면 UNK 토큰 반환
-    return token_2_id_map_.at(kUnkToken);
-  } else {  // 토큰이 존재하면 해당 ID 반환
-    return it->second;
+    return unk_id_;
   }
+  int id = find_token_(s);
+  return id < 0 ? unk_id_ : id;  // 토큰이 없으면 UNK 토큰 반환
 }
 
 // ID를 단어로 변환하는 함수
@@ -203,6 +515,7 @@ std::string BertTokenizer::Id2Word(int id) const {
 
 // 어휘 목록에서 토큰을 초기화하는 함수
 void BertTokenizer::init_from_lines(const std::vector<std::string>& lines) {
+  tokens_.clear();
   int idx = 0;
   for (size_t i = 0; i < lines.size(); i++) {
     std::string line = lines[i];
@@ -214,8 +527,7 @@ void BertTokenizer::init_from_lines(const std::vector<std::string>& lines) {
       continue;  // 비어 있는 줄은 건너뜁니다.
     }
     std::string token = line.substr(0, nn);
-    tokens_.push_back(token);  // 토큰 리스트에 추가
-    token_2_id_map_[token] = idx;  // 토큰과 ID를 맵에 추가
+    tokens_.push_back(token);  // 토큰 리스트에 추가 (ID는 리스트 위치)
     idx += 1;
   }
 }
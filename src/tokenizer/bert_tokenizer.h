@@ -10,6 +10,7 @@
  * -----
  */
 #pragma once
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -29,9 +30,19 @@ class BertTokenizer : public TextTokenizer,
   // 어휘 파일을 사용하여 초기화하는 함수
   bool Init(std::string vocab) override;
 
+  // 바이너리 어휘 사전의 캐시 디렉터리 설정. 비어 있으면(기본값) 캐시를 읽거나 쓰지 않습니다.
+  void SetCacheDir(const std::string& dir) override { cache_dir_ = dir; }
+
   // 파일 내용으로 초기화하는 함수
   bool InitByFileContent(std::string content);
 
+  // 어휘 사전을 바이너리 파일(트라이 포함)로 저장하는 함수. 원본 어휘 파일의 크기와 해시를 헤더에 기록합니다.
+  bool SaveBinary(const std::string& path, uint64_t source_size, uint64_t source_hash) const;
+
+  // 바이너리 어휘 사전을 로드하는 함수. 원본 크기나 해시가 다르거나,
+  // 파일이 잘렸거나 트라이 인덱스가 범위를 벗어나면 실패합니다.
+  bool LoadBinary(const std::string& path, uint64_t source_size, uint64_t source_hash);
+
   // 주어진 텍스트를 인코딩하여 토큰 ID 리스트를 반환하는 함수
   std::vector<int> Encode(std::string text) override;
 
@@ -61,7 +72,25 @@ class BertTokenizer : public TextTokenizer,
 
  private:
   // 문자열을 최대 길이로 분할하여 결과에 토큰 ID를 추가하는 함수
-  void max_seg_(std::string s, std::vector<int>& results);
+  void max_seg_(const std::string& s, std::vector<int>& results) const;
+
+  // ASCII 텍스트를 UTF-16 변환 없이 정리, 토큰화, 분할하는 함수
+  void encode_ascii_(const std::string& text, std::vector<int>& results) const;
+
+  // 토큰 리스트에서 트라이를 만드는 함수
+  void build_trie_();
+
+  // 로드한 트라이의 모든 노드와 간선 인덱스가 범위 안에 있는지 확인하는 함수
+  bool validate_trie_() const;
+
+  // 서브 토큰 시작 노드와 특수 토큰 ID를 찾는 함수. 특수 토큰이 없거나 Pad ID가 0이 아니면 실패
+  bool resolve_special_ids_();
+
+  // 트라이 노드의 자식 중 바이트 c에 해당하는 노드를 찾는 함수 (없으면 -1)
+  int32_t trie_child_(int32_t node, uint8_t c) const;
+
+  // 토큰의 ID를 찾는 함수 (없으면 -1)
+  int find_token_(const std::string& token) const;
 
   // 어휘 파일을 읽어들여 라인별로 저장하는 함수
   void load_vocab_(std::string path, std::vector<std::string>& lines);
@@ -75,12 +104,28 @@ class BertTokenizer : public TextTokenizer,
   // 텍스트를 정리하는 함수
   UString _clean(UString text);
 
-  // 토큰과 그에 대응하는 ID를 저장하는 맵
-  std::unordered_map<std::string, int> token_2_id_map_;
-
   // 토큰 목록을 저장하는 벡터
   std::vector<std::string> tokens_;
 
+  // 바이트 단위 트라이. 각 노드의 자식 간선은 trie_edges_에 바이트 순으로 연속 저장됩니다.
+  struct TrieNode {
+    int32_t token_id;     // 이 노드에서 끝나는 토큰 ID (-1은 없음)
+    uint32_t edge_begin;  // 첫 번째 자식 간선의 위치
+    uint32_t edge_count;  // 자식 간선 수
+  };
+  struct TrieEdge {
+    uint8_t byte;   // 간선 바이트
+    int32_t child;  // 자식 노드
+  };
+  std::vector<TrieNode> trie_nodes_;
+  std::vector<TrieEdge> trie_edges_;
+  int32_t suffix_root_ = -1;  // "##" 노드 (서브 토큰 검색의 시작점)
+
+  std::string cache_dir_;  // 바이너리 어휘 사전 캐시 디렉터리 (비어 있으면 사용 안 함)
+
+  // 특수 토큰 ID
+  int pad_id_ = -1, unk_id_ = -1, cls_id_ = -1, sep_id_ = -1, mask_id_ = -1;
+
   // 다양한 특수 토큰들을 정의합니다.
   static std::string kUnkToken;
   static std::string kMaskToken;
@@ -28,6 +28,9 @@ class TextTokenizer {
   // 어휘 파일을 초기화하는 가상 함수
   virtual bool Init(std::string vocab) = 0;
 
+  // 전처리된 어휘 사전을 캐시할 디렉터리를 설정하는 함수 (Init 전에 호출, 기본 구현은 무시)
+  virtual void SetCacheDir(const std::string& dir) { (void)dir; }
+
   // 텍스트를 인코딩하는 가상 함수
   virtual std::vector<int> Encode(std::string text) = 0;
 
@@ -0,0 +1,79 @@
+//
+// Contiguous storage of point correspondences.
+//
+
+#ifndef FMFUSION_CORRESPONDENCE_BUFFER_H
+#define FMFUSION_CORRESPONDENCE_BUFFER_H
+
+#include <algorithm>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace fmfusion {
+
+/// \brief Point correspondences produced by the point matcher and consumed by registration.
+///        Coordinates are stored as column-major (capacity,3) double matrices, so the solvers can
+///        use them without conversion. Only the first size() rows are valid; read them through
+///        src_rows() and ref_rows().
+struct CorrespondenceBuffer {
+    Eigen::MatrixX3d src_points;  // (capacity,3) source points
+    Eigen::MatrixX3d ref_points;  // (capacity,3) reference points
+    std::vector<int> match_indices;  // (C,) index of the matched node pair
+    std::vector<float> scores;  // (C,) correspondence scores
+
+    int size() const { return match_indices.size(); }
+
+    int capacity() const { return src_points.rows(); }
+
+    Eigen::MatrixX3d::ConstRowsBlockXpr src_rows() const { return src_points.topRows(size()); }
+
+    Eigen::MatrixX3d::ConstRowsBlockXpr ref_rows() const { return ref_points.topRows(size()); }
+
+    /// \brief Grow the point matrices to hold at least C correspondences.
+    void reserve(int C) {
+        if (C <= capacity()) return;
+        src_points.conservativeResize(C, 3);
+        ref_points.conservativeResize(C, 3);
+        match_indices.reserve(C);
+        scores.reserve(C);
+    }
+
+    /// \brief Make room for C more correspondences at the back. The capacity grows geometrically,
+    ///        so appending chunk by chunk stays linear in the total size.
+    /// \return Row of the first appended correspondence.
+    int extend(int C) {
+        int offset = size();
+        if (offset + C > capacity()) reserve(std::max(offset + C, 2 * capacity()));
+        match_indices.resize(offset + C);
+        scores.resize(offset + C);
+        return offset;
+    }
+
+    /// \brief Append the correspondences to Vector3d outputs, for the older vector based API.
+    void append_to(std::vector<Eigen::Vector3d> &corr_src_points,
+                   std::vector<Eigen::Vector3d> &corr_ref_points,
+                   std::vector<int> &corr_match_indices,
+                   std::vector<float> &corr_scores_vec) const {
+        int C = size();
+        size_t offset = corr_src_points.size();
+        corr_src_points.resize(offset + C);
+        corr_ref_points.resize(offset + C);
+        for (int i = 0; i < C; i++) {
+            corr_src_points[offset + i] = src_rows().row(i).transpose();
+            corr_ref_points[offset + i] = ref_rows().row(i).transpose();
+        }
+        corr_match_indices.insert(corr_match_indices.end(), match_indices.begin(), match_indices.end());
+        corr_scores_vec.insert(corr_scores_vec.end(), scores.begin(), scores.end());
+    }
+
+    /// \brief Drop the correspondences but keep the capacity for reuse.
+    void clear() {
+        match_indices.clear();
+        scores.clear();
+    }
+};
+
+}
+
+#endif //FMFUSION_CORRESPONDENCE_BUFFER_H
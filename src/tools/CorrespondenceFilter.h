@@ -0,0 +1,142 @@
+//
+// Grid-hashed non-maximum suppression for point correspondences.
+//
+
+#ifndef FMFUSION_CORRESPONDENCE_FILTER_H
+#define FMFUSION_CORRESPONDENCE_FILTER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace fmfusion {
+
+/// \brief Greedy NMS over correspondences: visit them by descending score and keep one only if no
+///        kept correspondence lies closer than dist_thd. Kept points are bucketed into dist_thd cells,
+///        so each candidate is only compared against the 27 neighbouring cells. The visiting order is
+///        produced lazily by partial sorting, so a max_keep limit avoids sorting every score.
+///        The filter owns its buffers and can be reused across calls without reallocating.
+class CorrespondenceNMS {
+public:
+    explicit CorrespondenceNMS(double dist_thd = 0.05) : dist_thd_(dist_thd) {}
+
+    void setDistThd(double dist_thd) { dist_thd_ = dist_thd; }
+
+    double distThd() const { return dist_thd_; }
+
+    /// \param points   (N,) correspondence positions used for suppression.
+    /// \param scores   (N,) correspondence scores. Higher is better.
+    /// \param max_keep Stop after keeping this many correspondences. Non-positive keeps all.
+    /// \return Indices of the kept correspondences, in descending score order.
+    ///         A non-positive dist_thd suppresses nothing and only orders by score.
+    template<typename PointAt>
+    std::vector<int> filter(int N, PointAt point_at, const std::vector<float> &scores, int max_keep = -1) {
+        std::vector<int> kept;
+        if (N <= 0) return kept;
+        if (max_keep <= 0 || max_keep > N) max_keep = N;
+        kept.reserve(max_keep);
+
+        order_.resize(N);
+        std::iota(order_.begin(), order_.end(), 0);
+        auto by_score = [&scores](int a, int b) {
+            return scores[a] > scores[b] || (scores[a] == scores[b] && a < b);
+        };
+        if (!(dist_thd_ > 0.0)) {
+            std::partial_sort(order_.begin(), order_.begin() + max_keep, order_.end(), by_score);
+            kept.assign(order_.begin(), order_.begin() + max_keep);
+            return kept;
+        }
+
+        cell_head_.clear();
+        cell_head_.reserve(2 * max_keep);
+        next_.assign(N, -1);
+        const double inv_cell = 1.0 / dist_thd_;
+        const double thd_sq = dist_thd_ * dist_thd_;
+
+        // Sort only a window of the best remaining scores, and grow it if NMS drains it.
+        size_t sorted = 0;
+        size_t window = std::min<size_t>(N, std::max(2 * max_keep, 64));
+        for (size_t i = 0; i < order_.size() && kept.size() < (size_t) max_keep; i++) {
+            if (i == sorted) {
+                size_t end = std::min(order_.size(), sorted + window);
+                std::partial_sort(order_.begin() + sorted, order_.begin() + end, order_.end(), by_score);
+                sorted = end;
+                window *= 2;
+            }
+
+            int idx = order_[i];
+            const Eigen::Vector3d p = point_at(idx);
+            int64_t cx = cellCoord(p.x() * inv_cell);
+            int64_t cy = cellCoord(p.y() * inv_cell);
+            int64_t cz = cellCoord(p.z() * inv_cell);
+
+            bool add = true;
+            for (int dx = -1; dx <= 1 && add; dx++) {
+                for (int dy = -1; dy <= 1 && add; dy++) {
+                    for (int dz = -1; dz <= 1 && add; dz++) {
+                        auto it = cell_head_.find(cellKey(cx + dx, cy + dy, cz + dz));
+                        if (it == cell_head_.end()) continue;
+                        for (int j = it->second; j >= 0; j = next_[j]) {
+                            if ((p - point_at(j)).squaredNorm() < thd_sq) {
+                                add = false;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+            if (!add) continue;
+
+            // Push the kept correspondence to the front of its cell list
+            auto inserted = cell_head_.emplace(cellKey(cx, cy, cz), idx);
+            if (!inserted.second) {
+                next_[idx] = inserted.first->second;
+                inserted.first->second = idx;
+            }
+            kept.push_back(idx);
+        }
+        return kept;
+    }
+
+    std::vector<int> filter(const std::vector<Eigen::Vector3d> &points, const std::vector<float> &scores,
+                            int max_keep = -1) {
+        return filter((int) points.size(), [&points](int i) { return points[i]; }, scores, max_keep);
+    }
+
+    std::vector<int> filter(const Eigen::MatrixX3d &points, const std::vector<float> &scores,
+                            int max_keep = -1) {
+        return filter((int) points.rows(), [&points](int i) { return Eigen::Vector3d(points.row(i)); },
+                      scores, max_keep);
+    }
+
+private:
+    // Clamp before the integer cast, which is undefined for out-of-range values. Only cells
+    // beyond +-2^40 share a coordinate, which keeps the result exact and only slows those points down.
+    static int64_t cellCoord(double v) {
+        const double limit = double(int64_t(1) << 40);
+        if (!(v > -limit)) return -(int64_t(1) << 40);  // also catches NaN
+        if (v > limit) return int64_t(1) << 40;
+        return (int64_t) std::floor(v);
+    }
+
+    // 21 bits per axis, enough for +-1e6 cells
+    static uint64_t cellKey(int64_t x, int64_t y, int64_t z) {
+        const int64_t offset = 1 << 20;
+        const uint64_t mask = (1 << 21) - 1;
+        return (uint64_t(x + offset) & mask) << 42 | (uint64_t(y + offset) & mask) << 21 | (uint64_t(z + offset) & mask);
+    }
+
+    double dist_thd_;
+    std::vector<int> order_;
+    std::vector<int> next_;  // next kept correspondence in the same cell, -1 terminates
+    std::unordered_map<uint64_t, int> cell_head_;  // cell -> last kept correspondence
+};
+
+}
+
+#endif //FMFUSION_CORRESPONDENCE_FILTER_H
@@ -248,7 +248,7 @@ namespace IO
             src_centroids.push_back(src_node->centroid);
             ref_centroids.push_back(ref_node->centroid);
             // msg<<"("<<src_node->instance_id<<","<<ref_node->instance_id<<") "
-            // <<"("<<src_node->semantic<<","<<ref_node->semantic<<")\n";
+            // <<"("<<src_node->get_semantic()<<","<<ref_node->get_semantic()<<")\n";
         }
 
         // std::cout<<msg.str()<<std::endl;
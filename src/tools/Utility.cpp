@@ -97,6 +97,8 @@ fmfusion::Config *create_scene_graph_config(const std::string &config_file, bool
         config->graph.voxel_size = graph_config_fs["voxel_size"];
         config->graph.involve_floor_edge = int_to_bool(graph_config_fs["involve_floor_edge"]);
         graph_config_fs["ignore_labels"]>>config->graph.ignore_labels;
+        if(!graph_config_fs["triplet_seed"].empty())
+            config->graph.triplet_seed = graph_config_fs["triplet_seed"];
 
         //
         auto shape_fs = fs["ShapeEncoder"];
@@ -105,18 +107,36 @@ fmfusion::Config *create_scene_graph_config(const std::string &config_file, bool
         config->shape_encoder.K_shape_samples = shape_fs["K_shape_samples"];
         config->shape_encoder.K_match_samples = shape_fs["K_match_samples"];
         shape_fs["padding"] >> config->shape_encoder.padding;
+        if(!shape_fs["sample_seed"].empty())
+            config->shape_encoder.sample_seed = shape_fs["sample_seed"];
 
         //
         auto sgnet_config_fs = fs["SGNet"];
         config->sgnet.triplet_number = sgnet_config_fs["triplet_number"];
         config->sgnet.warm_up_iter = sgnet_config_fs["warm_up"];
         config->sgnet.instance_match_threshold = sgnet_config_fs["instance_match_threshold"];
+        if(!sgnet_config_fs["device"].empty())
+            sgnet_config_fs["device"] >> config->sgnet.device;
+        if(!sgnet_config_fs["intra_op_threads"].empty())
+            config->sgnet.intra_op_threads = sgnet_config_fs["intra_op_threads"];
+        if(!sgnet_config_fs["onednn_fusion"].empty())
+            config->sgnet.onednn_fusion = int_to_bool(sgnet_config_fs["onednn_fusion"]);
+        if(!sgnet_config_fs["validation_level"].empty())
+            config->sgnet.validation_level = sgnet_config_fs["validation_level"];
+        if(!sgnet_config_fs["label_embedding_cache"].empty())
+            sgnet_config_fs["label_embedding_cache"] >> config->sgnet.label_embedding_cache;
+        if(!sgnet_config_fs["tokenizer_cache_dir"].empty())
+            sgnet_config_fs["tokenizer_cache_dir"] >> config->sgnet.tokenizer_cache_dir;
+        if(!sgnet_config_fs["profile_latency"].empty())
+            config->sgnet.profile_latency = int_to_bool(sgnet_config_fs["profile_latency"]);
 
         //
         auto lcd_fs = fs["LoopDetector"];
         config->loop_detector.fuse_shape = int_to_bool(lcd_fs["fuse_shape"]);
         config->loop_detector.lcd_nodes = lcd_fs["lcd_nodes"];
         config->loop_detector.recall_nodes = lcd_fs["recall_nodes"];
+        if(!lcd_fs["point_match_memory_mb"].empty())
+            config->loop_detector.point_match_memory_mb = lcd_fs["point_match_memory_mb"];
 
         //
         auto reg_fs = fs["Registration"];
@@ -7,6 +7,8 @@
 
 #include "back_end/reglib.h"
 #include "mapping/Instance.h"
+#include "tools/CorrespondenceBuffer.h"
+#include "tools/CorrespondenceFilter.h"
 #include "robot_utils/eigen_types.h"
 #include "utils/opt_utils.h"
 #include "back_end/pagor/pagor.h"
@@ -43,32 +45,22 @@ public:
                                                                      score_index_tuples_.begin() + k);
     }
 
-    // Returns the top K score-index pairs
+    // Returns the score-index pairs that survive greedy NMS, in descending score order
     std::vector<std::tuple<float, int, Eigen::Vector3d >> getNMS(double distThd) const {
-        std::vector<std::tuple<float, int, Eigen::Vector3d>> selectedTuples;
-        for (const auto &tuple: score_index_tuples_) {
-            bool keep = true;
-            const auto &confidence = std::get<0>(tuple);
-            const auto &point = std::get<2>(tuple);
-            // Check if the current point is too close to any of the previously selected points
-            for (const auto &selected: selectedTuples) {
-                if ((point - std::get<2>(selected)).norm() < distThd) {
-                    // Keep the one with higher confidence
-                    if (confidence < std::get<0>(selected)) {
-                        keep = false;
-                        break;
-                    } else {
-                        // The current point has higher confidence, so remove the previous one
-                        selectedTuples.erase(std::find(selectedTuples.begin(), selectedTuples.end(), selected));
-                    }
-                }
-            }
-
-            if (keep) {
-                selectedTuples.push_back(tuple);
-            }
+        std::vector<float> scores(score_index_tuples_.size());
+        for (size_t i = 0; i < score_index_tuples_.size(); i++) {
+            scores[i] = std::get<0>(score_index_tuples_[i]);
         }
+        fmfusion::CorrespondenceNMS nms(distThd);
+        const std::vector<int> &kept = nms.filter(
+                (int) score_index_tuples_.size(),
+                [this](int i) { return std::get<2>(score_index_tuples_[i]); }, scores);
 
+        std::vector<std::tuple<float, int, Eigen::Vector3d>> selectedTuples;
+        selectedTuples.reserve(kept.size());
+        for (int i: kept) {
+            selectedTuples.push_back(score_index_tuples_[i]);
+        }
         return selectedTuples;
     }
 
@@ -108,6 +100,7 @@ public:
     Config cfg_;
     VoxelMap3D voxel_map;
     FRGresult reg_result;
+    fmfusion::CorrespondenceNMS nms_filter;
 
     G3RegAPI(Config &cfg) : cfg_(cfg) {
 
@@ -149,6 +142,38 @@ public:
         }
     }
 
+    // Same as above, but reads the dense correspondences from contiguous (C,3) matrices.
+    // The dense block is copied into the solver input with a single block assignment.
+    void construct_corrp(const std::vector<Eigen::Vector3d> &src_centroids,
+                         const std::vector<Eigen::Vector3d> &ref_centroids,
+                         const fmfusion::CorrespondenceBuffer &corr, std::string corr_type,
+                         Eigen::MatrixX3d &src_corrp, Eigen::MatrixX3d &ref_corrp) {
+        int C = corr.size();
+        int N = src_centroids.size();
+        if (corr_type == "topk" && C > 0) {
+            std::vector<Eigen::Vector3d> corr_src_points(C), corr_ref_points(C);
+            for (int i = 0; i < C; i++) {
+                corr_src_points[i] = corr.src_rows().row(i).transpose();
+                corr_ref_points[i] = corr.ref_rows().row(i).transpose();
+            }
+            construct_corrp(src_centroids, ref_centroids, corr_src_points, corr_ref_points, corr.scores, corr_type,
+                            src_corrp, ref_corrp);
+            return;
+        } else if (corr_type != "none" && corr_type != "nms") {
+            std::cout << "corr_type not supported" << std::endl;
+            C = 0;
+        }
+        //    合并instance中心匹配和稠密点匹配
+        src_corrp.resize(C + N, 3);
+        ref_corrp.resize(C + N, 3);
+        src_corrp.topRows(C) = corr.src_rows().topRows(C);
+        ref_corrp.topRows(C) = corr.ref_rows().topRows(C);
+        for (int i = 0; i < N; i++) {
+            src_corrp.row(i + C) = src_centroids[i];
+            ref_corrp.row(i + C) = ref_centroids[i];
+        }
+    }
+
     void estimate_pose(const std::vector<Eigen::Vector3d> &src_centroids,
                        const std::vector<Eigen::Vector3d> &ref_centroids,
                        const std::vector<Eigen::Vector3d> &corr_src_points,
@@ -157,6 +182,29 @@ public:
                        const fmfusion::O3d_Cloud_Ptr &src_cloud_ptr,
                        const fmfusion::O3d_Cloud_Ptr &ref_cloud_ptr
     ) {
+        Eigen::MatrixX3d src_corrp, ref_corrp;
+        construct_corrp(src_centroids, ref_centroids, corr_src_points, corr_ref_points, corr_scores_vec, "nms",
+                        src_corrp, ref_corrp);
+        estimate_pose_from_corrp(src_corrp, ref_corrp, src_cloud_ptr, ref_cloud_ptr);
+    }
+
+    void estimate_pose(const std::vector<Eigen::Vector3d> &src_centroids,
+                       const std::vector<Eigen::Vector3d> &ref_centroids,
+                       const fmfusion::CorrespondenceBuffer &corr,
+                       const fmfusion::O3d_Cloud_Ptr &src_cloud_ptr,
+                       const fmfusion::O3d_Cloud_Ptr &ref_cloud_ptr
+    ) {
+        Eigen::MatrixX3d src_corrp, ref_corrp;
+        construct_corrp(src_centroids, ref_centroids, corr, "nms", src_corrp, ref_corrp);
+        estimate_pose_from_corrp(src_corrp, ref_corrp, src_cloud_ptr, ref_cloud_ptr);
+    }
+
+    // Solve the pose from merged (dense + instance centroid) correspondences.
+    void estimate_pose_from_corrp(const Eigen::MatrixX3d &src_corrp,
+                       const Eigen::MatrixX3d &ref_corrp,
+                       const fmfusion::O3d_Cloud_Ptr &src_cloud_ptr,
+                       const fmfusion::O3d_Cloud_Ptr &ref_cloud_ptr
+    ) {
 
         cfg_.vertex_info.type = clique_solver::VertexType::POINT;
         cfg_.tf_solver = "gnc"; //"quatro"; // gnc quatro
@@ -164,9 +212,6 @@ public:
         std::stringstream msg;
         double data_time = 0;
         robot_utils::TicToc t;
-        Eigen::MatrixX3d src_corrp, ref_corrp;
-        construct_corrp(src_centroids, ref_centroids, corr_src_points, corr_ref_points, corr_scores_vec, "nms",
-                        src_corrp, ref_corrp);
 
 //    求解位姿矩阵x
         const Eigen::MatrixX3d &src_cloud_mat = vectorToMatrix(src_cloud_ptr->points_);
@@ -313,7 +358,7 @@ public:
             // MergePointClouds(ref_cloud_ptr, ref_node->cloud);
 
             // msg << "(" << pair.first << "," << pair.second << ") "
-            //     << "(" << src_node->semantic << "," << ref_node->semantic << ")\n";
+            //     << "(" << src_node->get_semantic() << "," << ref_node->get_semantic() << ")\n";
         }
         data_time = t.toc();
         std::cout << msg.str() << std::endl;
@@ -339,11 +384,23 @@ public:
                              const std::vector<Eigen::Vector3d> &corr_src_points,
                              const std::vector<Eigen::Vector3d> &corr_ref_points,
                              const std::vector<float> &corr_scores_vec) {
-        cfg_.tf_solver = "quatro"; //"quatro"; // gnc quatro
-        double inlier_ratio;
         Eigen::MatrixX3d src_corrp, ref_corrp;
         construct_corrp(src_centroids, ref_centroids, corr_src_points, corr_ref_points, corr_scores_vec, "nms",
                         src_corrp, ref_corrp);
+        return estimate_pose_gnc(src_corrp, ref_corrp);
+    }
+
+    double estimate_pose_gnc(const std::vector<Eigen::Vector3d> &src_centroids,
+                             const std::vector<Eigen::Vector3d> &ref_centroids,
+                             const fmfusion::CorrespondenceBuffer &corr) {
+        Eigen::MatrixX3d src_corrp, ref_corrp;
+        construct_corrp(src_centroids, ref_centroids, corr, "nms", src_corrp, ref_corrp);
+        return estimate_pose_gnc(src_corrp, ref_corrp);
+    }
+
+    double estimate_pose_gnc(const Eigen::MatrixX3d &src_corrp, const Eigen::MatrixX3d &ref_corrp) {
+        cfg_.tf_solver = "quatro"; //"quatro"; // gnc quatro
+        double inlier_ratio;
 
         Eigen::Matrix4d T = solveSE3byGNC(src_corrp.transpose(), ref_corrp.transpose());
 
@@ -414,29 +471,8 @@ public:
 
     std::vector<int> downsample_corr_nms(const std::vector<Eigen::Vector3d> &corr_src_points,
                                          const std::vector<float> &corr_scores_vec, double distThd) {
-        std::vector<int> indices;
-
-        // Mapping from sorted scores back to original indices.
-        std::vector<int> score_indices(corr_scores_vec.size());
-        std::iota(score_indices.begin(), score_indices.end(), 0);
-        std::sort(score_indices.begin(), score_indices.end(),
-                  [&corr_scores_vec](int i1, int i2) { return corr_scores_vec[i1] > corr_scores_vec[i2]; });
-
-        // Use NMS to downsample
-        for (int idx: score_indices) {
-            bool add = true;
-            for (size_t j = 0; j < indices.size() && add; ++j) {
-                double dist = (corr_src_points[idx] - corr_src_points[indices[j]]).norm();
-                if (dist < distThd) {
-                    add = false;
-                }
-            }
-            if (add) {
-                indices.push_back(idx);
-            }
-        }
-
-        return indices;
+        nms_filter.setDistThd(distThd);
+        return nms_filter.filter(corr_src_points, corr_scores_vec);
     }
 
 
@@ -611,23 +647,39 @@ public:
         return result_icp.transformation_;
     }
 
+    // Weighted point-to-point SE3 by streaming 3x3 sums. No dynamic allocation.
+    // H = sum_i w_i (s_i - ms)(t_i - mt)^T = sum_i w_i s_i t_i^T - W ms mt^T, with weighted means ms, mt.
     Eigen::Matrix4d svdSE3(const Eigen::Matrix3Xd &src, const Eigen::Matrix3Xd &tgt,
                            const Eigen::Matrix<double, 1, Eigen::Dynamic> &W) {
-        Eigen::Vector3d src_mean = src.rowwise().mean();
-        Eigen::Vector3d tgt_mean = tgt.rowwise().mean();
-        const Eigen::Matrix3Xd &src_centered = src - src_mean.replicate(1, src.cols());
-        const Eigen::Matrix3Xd &tgt_centered = tgt - tgt_mean.replicate(1, tgt.cols());
-        Eigen::MatrixXd H = src_centered * W.asDiagonal() * tgt_centered.transpose();
-        Eigen::JacobiSVD<Eigen::MatrixXd> svd(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
-        Eigen::MatrixXd R_ = svd.matrixV() * svd.matrixU().transpose();
+        double w_sum = 0;
+        Eigen::Vector3d src_sum = Eigen::Vector3d::Zero();
+        Eigen::Vector3d tgt_sum = Eigen::Vector3d::Zero();
+        Eigen::Matrix3d cross_sum = Eigen::Matrix3d::Zero();
+        for (Eigen::Index i = 0; i < src.cols(); ++i) {
+            const double w = W(i);
+            if (w <= 0) continue;
+            w_sum += w;
+            src_sum += w * src.col(i);
+            tgt_sum += w * tgt.col(i);
+            cross_sum.noalias() += (w * src.col(i)) * tgt.col(i).transpose();
+        }
+        Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+        if (w_sum < 1e-12) {
+            return T;
+        }
+        Eigen::Vector3d src_mean = src_sum / w_sum;
+        Eigen::Vector3d tgt_mean = tgt_sum / w_sum;
+        Eigen::Matrix3d H = cross_sum - w_sum * src_mean * tgt_mean.transpose();
+
+        Eigen::JacobiSVD<Eigen::Matrix3d> svd(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
+        Eigen::Matrix3d V = svd.matrixV();
+        Eigen::Matrix3d R_ = V * svd.matrixU().transpose();
         if (R_.determinant() < 0) {
-            Eigen::MatrixXd V = svd.matrixV();
             V.col(2) *= -1;
             R_ = V * svd.matrixU().transpose();
         }
-        Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
-        T.block(0, 0, 3, 3) = R_;
-        T.block(0, 3, 3, 1) = tgt_mean - R_ * src_mean;
+        T.block<3, 3>(0, 0) = R_;
+        T.block<3, 1>(0, 3) = tgt_mean - R_ * src_mean;
         return T;
     }
 
@@ -638,29 +690,31 @@ public:
         double cost_threshold = 1e-6;
         int max_iterations = 100;
 
-        // assert(rotation);                 // make sure R is not a nullptr
         assert(src.cols() == dst.cols()); // check dimensions of input data
         assert(gnc_factor > 1);   // make sure mu will increase        gnc_factor -> rotation_gnc_factor
-        // assert(params_.noise_bound != 0); // make sure noise sigma is not zero
 
         // Prepare some variables
         Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
         size_t match_size = src.cols(); // number of correspondences
+        if (match_size == 0) {
+            return T;
+        }
 
         double mu = 1; // arbitrary starting mu
 
         double prev_cost = std::numeric_limits<double>::infinity();
         double cost = std::numeric_limits<double>::infinity();
-        static double noise_bound_sq = std::pow(noise_bound, 2);
+        // Computed per call. It used to be a function-local static, which froze the first call's bound
+        double noise_bound_sq = std::pow(noise_bound, 2);
         if (noise_bound_sq < 1e-16) {
             noise_bound_sq = 1e-2;
         }
-        // TEASER_DEBUG_INFO_MSG("GNC rotation estimation noise bound:" << params_.noise_bound);
         TEASER_DEBUG_INFO_MSG("GNC rotation estimation noise bound squared:" << noise_bound_sq);
 
-        Eigen::Matrix<double, 3, Eigen::Dynamic> diffs(3, match_size);
+        // Buffers are allocated once; every iteration writes into them in place
+        Eigen::Matrix3Xd diffs(3, match_size);
         Eigen::Matrix<double, 1, Eigen::Dynamic> weights(1, match_size);
-        weights.setOnes(1, match_size);
+        weights.setOnes();
         Eigen::Matrix<double, 1, Eigen::Dynamic> residuals_sq(1, match_size);
 
         // Loop for performing GNC-TLS
@@ -670,9 +724,10 @@ public:
             T = svdSE3(src, dst, weights);
 
             // Calculate residuals squared
-            //diffs = (dst - (*rotation) * src).array().square();
-            diffs = (dst - T.block(0, 0, 3, 3) * src - T.block(0, 3, 3, 1).replicate(1, match_size)).array().square();
-            residuals_sq = diffs.colwise().sum();
+            diffs.noalias() = T.block<3, 3>(0, 0) * src;
+            diffs.colwise() += T.block<3, 1>(0, 3);
+            diffs -= dst;
+            residuals_sq = diffs.colwise().squaredNorm();
             if (i == 0) {
                 // Initialize rule for mu
                 double max_residual = residuals_sq.maxCoeff();
@@ -685,24 +740,17 @@ public:
                     break;
                 }
             }
+            // The cost uses the previously solved weights
+            cost = weights.dot(residuals_sq);
+
             // Fix R and solve for weights in closed form
             double th1 = (mu + 1) / mu * noise_bound_sq;
             double th2 = mu / (mu + 1) * noise_bound_sq;
-            cost = 0;
-            for (size_t j = 0; j < match_size; ++j) {
-                // Also calculate cost in this loop
-                // Note: the cost calculated is using the previously solved weights
-                cost += weights(j) * residuals_sq(j);
-
-                if (residuals_sq(j) >= th1) {
-                    weights(j) = 0;
-                } else if (residuals_sq(j) <= th2) {
-                    weights(j) = 1;
-                } else {
-                    weights(j) = sqrt(noise_bound_sq * mu * (mu + 1) / residuals_sq(j)) - mu;
-                    assert(weights(j) >= 0 && weights(j) <= 1);
-                }
-            }
+            const double scale = noise_bound_sq * mu * (mu + 1);
+            weights = (residuals_sq.array() >= th1).select(
+                    0.0, (residuals_sq.array() <= th2).select(
+                            1.0, (scale / residuals_sq.array()).sqrt() - mu));
+
             // Calculate cost
             double cost_diff = std::abs(cost - prev_cost);
 
@@ -725,27 +773,8 @@ public:
 inline void
 downsample_corr_nms(std::vector<Eigen::Vector3d> &corr_src_points, std::vector<Eigen::Vector3d> &corr_tgt_points,
                     std::vector<float> &corr_scores_vec, double distThd) {
-    std::vector<int> indices;
-
-    // Mapping from sorted scores back to original indices.
-    std::vector<int> score_indices(corr_scores_vec.size());
-    std::iota(score_indices.begin(), score_indices.end(), 0);
-    std::sort(score_indices.begin(), score_indices.end(),
-              [&corr_scores_vec](int i1, int i2) { return corr_scores_vec[i1] > corr_scores_vec[i2]; });
-
-    // Use NMS to downsample
-    for (int idx: score_indices) {
-        bool add = true;
-        for (size_t j = 0; j < indices.size() && add; ++j) {
-            double dist = (corr_src_points[idx] - corr_src_points[indices[j]]).norm();
-            if (dist < distThd) {
-                add = false;
-            }
-        }
-        if (add) {
-            indices.push_back(idx);
-        }
-    }
+    fmfusion::CorrespondenceNMS nms(distThd);
+    std::vector<int> indices = nms.filter(corr_src_points, corr_scores_vec);
 
     // change corr_src_points and corr_tgt_points
     int original_size = corr_src_points.size();